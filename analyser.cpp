@@ -1,11 +1,284 @@
 /* Created by Darren Otgaar on 2016/12/04. http://www.github.com/otgaard/zap */
 #include "analyser.hpp"
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "dsp/cpu_features.hpp"
+#include "dsp/spectrum_ops.hpp"
+#include "dsp/fft.hpp"
+
+#if defined(ZAPPLAYER_SSE2)
+#include <emmintrin.h>
+#endif
+
+constexpr float envelope_seconds = 6.f;         // Length of the onset envelope used for tempo estimation
+constexpr float detrend_seconds = .5f;          // Time constant of the moving mean removed from the envelope
+constexpr float tempo_update_seconds = .25f;    // All lags are recomputed over this period
+constexpr float tempo_prior_bpm = 120.f;        // Centre of the log-Gaussian tempo prior
+constexpr float tempo_prior_octaves = 1.f;      // Standard deviation of the prior in octaves
+constexpr size_t phase_periods = 4;             // Beat periods correlated against the pulse train
+constexpr float pitch_peak_ratio = .85f;        // The first ACF peak this close to the maximum is the fundamental
+constexpr float cepstrum_range_db = 60.f;       // Dynamic range of the log spectrum used for the cepstrum
 
 struct analyser::state_t {
+    float frame_rate;
+    size_t min_lag, max_lag;
+    std::vector<float> prev_db;
+
+    size_t length;                  // Frames in the onset envelope
+    std::vector<float> envelope;    // Mirrored so that the last length frames are always contiguous
+    size_t write;
+    float mean;
+    float mean_coef;
+    float variance;
+
+    std::vector<float> acf;         // Autocorrelation for lags [0, max_lag+1]
+    std::vector<float> prior;
+    size_t lag_cursor;
+    size_t lags_per_frame;
+
+    float period;                   // Beat period in frames
+    beat_state beat;
+
+    pitch_method method;
+    const real_fft* fft;
+    float sample_rate;
+    size_t min_pitch_lag, max_pitch_lag;
+    std::vector<float> spectrum_re, spectrum_im;
+    std::vector<float> lags, work;
+    pitch_state pitch;
+
+    state_t(float frame_rate, float min_bpm, float max_bpm) : frame_rate(frame_rate),
+        min_lag(std::max<size_t>(1, size_t(std::floor(60.f*frame_rate/max_bpm)))),
+        max_lag(size_t(std::ceil(60.f*frame_rate/min_bpm))), length(std::max(size_t(envelope_seconds*frame_rate),
+        2*max_lag + 2)), envelope(2*length, 0.f), write(0), mean(0.f),
+        mean_coef(smoothing_coefficient(detrend_seconds, frame_rate)), variance(0.f), acf(max_lag + 2, 0.f),
+        prior(max_lag + 2, 0.f), lag_cursor(0), period(0.f), beat{0.f, 0.f, 0.f, false},
+        method(pitch_method::PM_NONE), fft(nullptr), sample_rate(0.f), min_pitch_lag(0), max_pitch_lag(0),
+        pitch{0.f, 0.f} {
+        const size_t update_frames = std::max<size_t>(1, size_t(tempo_update_seconds*frame_rate));
+        lags_per_frame = (acf.size() + update_frames - 1)/update_frames;
+
+        for(size_t lag = min_lag; lag <= max_lag; ++lag) {
+            const float octaves = std::log2(60.f*frame_rate/(lag*tempo_prior_bpm));
+            prior[lag] = std::exp(-.5f*octaves*octaves/(tempo_prior_octaves*tempo_prior_octaves));
+        }
+    }
+
+    const float* window() const { return envelope.data() + write; }
+
+    float spectral_flux(const float* bands_db, size_t bands);
+    void push_onset(float value);
+    void update_tempo();
+    void update_phase();
+    void update_pitch(const float* power);
 };
 
-analyser::analyser() : state_(new state_t()), s(*state_.get()) {
+analyser::analyser(float frame_rate, float min_bpm, float max_bpm)
+    : state_(new state_t(frame_rate, min_bpm, max_bpm)), s(*state_.get()) {
 }
 
 analyser::~analyser() = default;
 
+const beat_state& analyser::beat() const {
+    return s.beat;
+}
+
+const pitch_state& analyser::pitch() const {
+    return s.pitch;
+}
+
+void analyser::set_pitch_model(pitch_method method, const real_fft* fft, float sample_rate, float min_hz,
+                               float max_hz) {
+    s.method = fft ? method : pitch_method::PM_NONE;
+    s.fft = fft;
+    s.sample_rate = sample_rate;
+    s.pitch = pitch_state{0.f, 0.f};
+    if(!fft) return;
+
+    const size_t N = fft->size();
+    s.min_pitch_lag = std::max<size_t>(2, size_t(sample_rate/max_hz));
+    s.max_pitch_lag = std::min(size_t(std::ceil(sample_rate/min_hz)), N/2 - 1);
+    s.spectrum_re.assign(fft->bins(), 0.f);
+    s.spectrum_im.assign(fft->bins(), 0.f);
+    s.lags.assign(N, 0.f);
+    s.work.assign(N, 0.f);
+}
+
+void analyser::process_spectrum(const float* power, size_t bins) {
+    if(s.method == pitch_method::PM_NONE || bins != s.spectrum_re.size()) return;
+    s.update_pitch(power);
+}
+
+void analyser::process(const float* bands_db, size_t bands) {
+    if(s.period > 0.f) {
+        s.beat.phase += 1.f/s.period;
+        s.beat.phase -= std::floor(s.beat.phase);
+    }
+
+    s.push_onset(s.spectral_flux(bands_db, bands));
+
+    // Compute a bounded slice of the autocorrelation every frame, the estimate is updated once all lags are done
+    const float* x = s.window();
+    const size_t end = std::min(s.lag_cursor + s.lags_per_frame, s.acf.size());
+    for(size_t lag = s.lag_cursor; lag != end; ++lag) {
+        s.acf[lag] = dot_product(x + lag, x, s.length - lag);
+    }
+    s.lag_cursor = end;
+    if(s.lag_cursor == s.acf.size()) {
+        s.lag_cursor = 0;
+        s.update_tempo();
+    }
+}
+
+float analyser::state_t::spectral_flux(const float* bands_db, size_t bands) {
+    if(prev_db.size() != bands) prev_db.assign(bands_db, bands_db + bands);
+
+    size_t i = 0;
+    float flux = 0.f;
+#if defined(ZAPPLAYER_SSE2)
+    __m128 acc = _mm_setzero_ps();
+    for(; i + 4 <= bands; i += 4) {
+        const __m128 curr = _mm_loadu_ps(bands_db + i);
+        acc = _mm_add_ps(acc, _mm_max_ps(_mm_sub_ps(curr, _mm_loadu_ps(prev_db.data() + i)), _mm_setzero_ps()));
+        _mm_storeu_ps(prev_db.data() + i, curr);
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, acc);
+    flux = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+    for(; i != bands; ++i) {
+        flux += std::max(bands_db[i] - prev_db[i], 0.f);
+        prev_db[i] = bands_db[i];
+    }
+    return flux/bands;
+}
+
+void analyser::state_t::push_onset(float value) {
+    // Remove the local mean and half-wave rectify so that only rises in flux contribute
+    mean += mean_coef * (value - mean);
+    const float onset = std::max(value - mean, 0.f);
+    variance += mean_coef * (onset*onset - variance);
+    beat.onset = onset > 2.f*std::sqrt(variance) && onset > 0.f;
+
+    envelope[write] = onset;
+    envelope[write + length] = onset;
+    write = (write + 1) % length;
+}
+
+void analyser::state_t::update_tempo() {
+    if(acf[0] <= 0.f) return;
+
+    size_t best = 0;
+    float best_score = 0.f;
+    for(size_t lag = min_lag; lag <= max_lag; ++lag) {
+        const float score = prior[lag] * acf[lag];
+        if(score > best_score) {
+            best_score = score;
+            best = lag;
+        }
+    }
+    if(best == 0) return;
+
+    // Parabolic interpolation of the peak for a fractional period
+    const float a = acf[best-1], b = acf[best], c = acf[best+1];
+    const float denom = a - 2.f*b + c;
+    const float offset = denom < 0.f ? std::min(std::max(.5f*(a - c)/denom, -.5f), .5f) : 0.f;
+
+    period = best + offset;
+    beat.bpm = 60.f*frame_rate/period;
+    beat.confidence = std::min(std::max(b/acf[0], 0.f), 1.f);
+    update_phase();
+}
+
+void analyser::state_t::update_phase() {
+    // Frames since the last beat are found by correlating the newest periods of the envelope with a pulse train
+    const float* x = window();
+    const size_t P = size_t(period + .5f);
+    size_t best = 0;
+    float best_score = -1.f;
+    for(size_t phi = 0; phi != P; ++phi) {
+        float score = 0.f;
+        for(size_t k = 0; k != phase_periods; ++k) {
+            const size_t idx = phi + size_t(k*period + .5f);
+            if(idx < length) score += x[length - 1 - idx];
+        }
+        if(score > best_score) {
+            best_score = score;
+            best = phi;
+        }
+    }
+
+    // Pull the running phase half way towards the measurement to avoid jumps
+    const float measured = best/period;
+    float error = measured - beat.phase;
+    error -= std::floor(error + .5f);
+    beat.phase += .5f*error;
+    beat.phase -= std::floor(beat.phase);
+}
+
+void analyser::state_t::update_pitch(const float* power) {
+    const size_t bins = spectrum_re.size();
+    if(method == pitch_method::PM_AUTOCORRELATION) {
+        // Wiener-Khinchin: the autocorrelation is the inverse transform of the power spectrum
+        std::copy(power, power + bins, spectrum_re.begin());
+    } else {
+        // Floor the log spectrum below the peak so that empty bins do not dominate the cepstrum
+        power_to_db(power, spectrum_re.data(), bins);
+        const float floor = *std::max_element(spectrum_re.begin(), spectrum_re.end()) - cepstrum_range_db;
+        for(auto& v : spectrum_re) v = std::max(v, floor) - floor;
+    }
+
+    fft->inverse(spectrum_re.data(), spectrum_im.data(), lags.data(), work.data());
+
+    if(min_pitch_lag + 1 >= max_pitch_lag || (method == pitch_method::PM_AUTOCORRELATION && lags[0] <= 0.f)) {
+        pitch = pitch_state{0.f, 0.f};
+        return;
+    }
+
+    size_t best = 0;
+    float peak = 0.f;
+    for(size_t lag = min_pitch_lag; lag < max_pitch_lag; ++lag) peak = std::max(peak, lags[lag]);
+
+    if(method == pitch_method::PM_AUTOCORRELATION) {
+        // Take the first local maximum near the global maximum to avoid choosing a multiple of the period
+        for(size_t lag = min_pitch_lag; lag < max_pitch_lag; ++lag) {
+            if(lags[lag] >= pitch_peak_ratio*peak && lags[lag] >= lags[lag-1] && lags[lag] >= lags[lag+1]) {
+                best = lag;
+                break;
+            }
+        }
+    } else {
+        for(size_t lag = min_pitch_lag; lag < max_pitch_lag; ++lag) {
+            if(lags[lag] == peak) {
+                best = lag;
+                break;
+            }
+        }
+    }
+
+    if(best == 0 || peak <= 0.f) {
+        pitch = pitch_state{0.f, 0.f};
+        return;
+    }
+
+    const float a = lags[best-1], b = lags[best], c = lags[best+1];
+    const float denom = a - 2.f*b + c;
+    const float offset = denom < 0.f ? std::min(std::max(.5f*(a - c)/denom, -.5f), .5f) : 0.f;
+    pitch.frequency = sample_rate/(best + offset);
+
+    if(method == pitch_method::PM_AUTOCORRELATION) {
+        pitch.confidence = std::min(std::max(b/lags[0], 0.f), 1.f);
+    } else {
+        // The cepstral peak measured against the spread of the quefrency range
+        float mean = 0.f, sq = 0.f;
+        const size_t count = max_pitch_lag - min_pitch_lag;
+        for(size_t lag = min_pitch_lag; lag < max_pitch_lag; ++lag) {
+            mean += lags[lag];
+            sq += lags[lag]*lags[lag];
+        }
+        mean /= count;
+        const float stddev = std::sqrt(std::max(sq/count - mean*mean, 0.f));
+        pitch.confidence = stddev > 0.f ? std::min(std::max((b - mean)/(6.f*stddev), 0.f), 1.f) : 0.f;
+    }
+}
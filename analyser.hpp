@@ -3,6 +3,7 @@
 #define ZAPPLAYER_ANALYSER_HPP
 
 #include <memory>
+#include <cstddef>
 
 /*
  * The spectral analyser.
@@ -32,13 +33,59 @@
  *
  * Soft real-time.
  *
+ * Beat detection is implemented as follows: the spectral flux (the summed positive change in dB per band) of each
+ * analysis frame forms an onset envelope, which is detrended and kept in a rolling window of a few seconds.  The
+ * autocorrelation of the window over the lags between min_bpm and max_bpm is weighted by a tempo prior and its peak
+ * gives the tempo.  The lags are computed a slice per frame so the cost of every frame is bounded.  The beat phase
+ * is found by correlating the envelope with a pulse train at the estimated period and is advanced every frame.
+ *
+ * Pitch is estimated from the power spectrum of each frame with the analysing stream's own FFT plan, so neither model
+ * needs a second transform pipeline and both are O(N log N):
+ *    PM_AUTOCORRELATION    The inverse transform of the power spectrum is the (circular) autocorrelation
+ *    PM_CEPSTRUM           The inverse transform of the log power spectrum is the real cepstrum
+ * The strongest peak between the lags of max_hz and min_hz is refined by parabolic interpolation.  Lags are limited to
+ * half the transform size to avoid the circular wrap, so low pitches need a large transform (2048+ at 44.1 kHz).
  */
 
+class real_fft;
+
+struct beat_state {
+    float bpm;              // Estimated tempo, 0 until the first estimate
+    float phase;            // Position within the current beat in [0, 1), 0 is on the beat
+    float confidence;       // [0, 1]
+    bool onset;             // An onset was detected in this frame
+};
+
+struct pitch_state {
+    float frequency;        // Fundamental in Hz, 0 if none was found
+    float confidence;       // [0, 1]
+};
+
+enum class pitch_method {
+    PM_NONE,
+    PM_AUTOCORRELATION,
+    PM_CEPSTRUM
+};
+
 class analyser {
 public:
-    analyser();
+    // frame_rate is the number of analysis frames per second (sample rate/hop size)
+    explicit analyser(float frame_rate, float min_bpm=60.f, float max_bpm=200.f);
     ~analyser();
 
+    // Processes one frame of band levels in dB
+    void process(const float* bands_db, size_t bands);
+
+    // Enables pitch estimation on the power spectra of frames transformed by fft, which must outlive the analyser
+    void set_pitch_model(pitch_method method, const real_fft* fft, float sample_rate, float min_hz=50.f,
+                         float max_hz=1000.f);
+
+    // Processes the power spectrum (fft->bins() values) of one frame
+    void process_spectrum(const float* power, size_t bins);
+
+    const beat_state& beat() const;
+    const pitch_state& pitch() const;
+
 protected:
 
 private:
@@ -1,142 +1,479 @@
 /* Created by Darren Otgaar on 2016/11/19. http://www.github.com/otgaard/zap */
 #include <cmath>
+#include <chrono>
+#include <algorithm>
 #include <zap/maths/maths.hpp>
 #include "analyser_stream.hpp"
 
 #define LOGGING_ENABLED
 #include <zap/tools/log.hpp>
 
-/*
- * Note: This FFT implementation is based on the excellent FFT tutorial at:
- * http://blogs.zynaptiq.com/bernsee/dft-a-pied/
- */
+// The tap ring holds this many samples before the audio thread starts dropping samples from the analysis
+constexpr static size_t tap_capacity = 64*1024;
+// The analysis thread drains the tap ring in chunks of up to this many samples
+constexpr static size_t tap_chunk = 4096;
+// Frames kept for frame_at(), at a 256 sample hop this covers 186ms of device latency at 44.1kHz
+constexpr static size_t history_frames = 32;
+// Tracks announced ahead of the analysis, a buffered source runs at most a few tracks ahead
+constexpr static size_t track_marker_capacity = 8;
+constexpr static float level_floor = 1e-20f;
+// Full scale of the s16 samples, matching the float path in stft
+constexpr static float s16_inv = 1.f/32767.f;
 
-constexpr float s16_inv = 1.f/std::numeric_limits<short>::max();
+// The resolutions described by config, a single resolution unless config.resolutions is set
+static std::vector<resolution_config> make_layout(const analyser_config& config) {
+    if(!config.resolutions.empty()) return config.resolutions;
+    return { resolution_config{config.fft_size, config.bins, config.min_frequency, config.max_frequency} };
+}
 
-// Triangular smoothing function
-constexpr static float tri_smooth[5] = { 1.f, 2.f, 3.f, 2.f, 1.f };
-constexpr static float inv_tri = 1.f/9.f; // or 1/5 for box smoothing && { 1, 1, 1, 1, 1 };
+static size_t largest_fft(const analyser_config& config) {
+    size_t size = 0;
+    for(const auto& res : make_layout(config)) size = std::max(size, res.fft_size);
+    return size;
+}
 
-analyser_stream::analyser_stream(audio_stream<sample_t>* parent, size_t frame_size, size_t bins)
-        : audio_stream<sample_t>(parent), frame_size_(frame_size), bins_(bins), transform_buffer_(frame_size_*2),
-          prev_bin_buffer_(bins_), curr_bin_buffer_(bins_), prev_(frame_size_*2, 0.f), curr_(frame_size*2, 0.f),
-          smoothing_(5*bins_, 0.f) {
+static analyser_config validate_config(const analyser_config& config) {
+    analyser_config result = config;
+    if(result.channels < 2 && result.stereo != stereo_mode::SM_MONO) {
+        LOG_ERR("Stereo analysis requires two channels, analysing mono");
+        result.stereo = stereo_mode::SM_MONO;
+    }
+    return result;
 }
 
-size_t analyser_stream::read(buffer_t& buffer, size_t len) {
-    if(!parent()) return 0;
+// Shorter frames are delayed by half the difference in length so that all frames share the same centre
+std::vector<analyser_stream::resolution_ptr> analyser_stream::make_resolutions(const analyser_config& config) {
+    const size_t history = largest_fft(config);
+    std::vector<resolution_ptr> resolutions;
+    size_t band_offset = 0;
+    for(const auto& res : make_layout(config)) {
+        resolutions.emplace_back(new resolution(res, config, (history - res.fft_size)/2, band_offset));
+        band_offset += resolutions.back()->filters.bands();
+    }
+    return resolutions;
+}
 
-    size_t ret = parent()->read(buffer, len);
-    if(len != 2*frame_size_) {
-        LOG("Error, frame_size mismatch");
-        return ret;
+analyser_stream::resolution::resolution(const resolution_config& config, const analyser_config& analyser,
+                                        size_t delay, size_t band_offset)
+        : fft(config.fft_size), window(get_window(analyser.window, config.fft_size)),
+          filters(analyser.scale, config.bins, config.fft_size, float(analyser.sample_rate), config.min_frequency,
+                  config.max_frequency), delay(delay), band_offset(band_offset), frame(fft.size()), re(fft.bins()),
+          im(fft.bins()), power(fft.bins()), width(0.f) {
+    if(filters.bands() != config.bins) LOG_ERR("The filter bank produces fewer bands than requested");
+    if(analyser.stereo != stereo_mode::SM_MONO) {
+        pair.reset(new stereo_fft(config.fft_size));
+        side_frame.resize(fft.size());
+        side_re.resize(fft.bins());
+        side_im.resize(fft.bins());
+        side_power.resize(fft.bins());
+    }
+    if(analyser.arithmetic == fft_arithmetic::FA_Q15) {
+        q15.reset(new q15_real_fft(config.fft_size));
+        q15_window.resize(fft.size());
+        float_to_q15(window->data(), q15_window.data(), fft.size());
+        q15_re.resize(fft.bins());
+        q15_im.resize(fft.bins());
+        samples.resize(fft.size());
     }
+}
 
-    process_samples(buffer);
+analyser_stream::analyser_stream(audio_stream<sample_t>* parent, const analyser_config& config)
+        : audio_stream<sample_t>(parent), config_(validate_config(config)), resolutions_(make_resolutions(config_)),
+          stft_(largest_fft(config_), config_.hop_size, config_.channels),
+          bins_(resolutions_.back()->band_offset + resolutions_.back()->filters.bands()), bands_(bins_),
+          side_bands_(config_.stereo != stereo_mode::SM_MONO ? bins_ : 0),
+          bin_frames_(bin_frame{0, frame_clock::time_point(), 0, fft_buffer_t(bins_, 0.f),
+                                fft_buffer_t(side_bands_.size(), 0.f), 0.f, 0.f, beat_state{0.f, 0.f, 0.f, false},
+                                pitch_state{0.f, 0.f}}),
+          history_(history_frames, bin_frames_.front()), older_(bin_frames_.front()), newer_(bin_frames_.front()),
+          sequence_(0), smoother_(bins_), side_smoother_(side_bands_.size()),
+          analyser_(float(config_.sample_rate)/config_.hop_size), track_markers_(track_marker_capacity),
+          next_track_{0, nullptr, 0}, has_next_track_(false), track_start_(0), track_key_(0), recording_(false),
+          meter_(float(config_.sample_rate), config_.channels), hop_samples_(config_.hop_size*config_.channels),
+          hop_channel_(config_.hop_size), mode_(config_.mode),
+          tap_ring_(mode_ == analysis_mode::AM_TAP ? tap_capacity : 1),
+          tap_block_(mode_ == analysis_mode::AM_TAP ? tap_chunk : 0), running_(false), dropped_samples_(0) {
+    const float frame_rate = float(config_.sample_rate)/config_.hop_size;
+    const float attack = smoothing_coefficient(config_.attack_time, frame_rate);
+    const float release = smoothing_coefficient(config_.release_time, frame_rate);
+    smoother_.set_coefficients(attack, release);
+    side_smoother_.set_coefficients(attack, release);
+    // The pitch model uses the first resolution
+    analyser_.set_pitch_model(config_.pitch, &resolutions_.front()->fft, float(config_.sample_rate),
+                              config_.min_pitch, config_.max_pitch);
 
-    const float inv_transform_size = 2.f/transform_buffer_.size();
+    resolution_task_ = [this](size_t idx) { analyse_resolution(idx); };
 
-    {
-        std::unique_lock<std::mutex> lock(bin_buffer_mtx_);
-        prev_bin_buffer_ = curr_bin_buffer_;
+    if(mode_ == analysis_mode::AM_TAP) {
+        // The audio thread must never wait on the pool so resolutions are only run in parallel in AM_TAP mode
+        if(resolutions_.size() > 1 && config_.analysis_threads > 0) {
+            pool_.reset(new worker_pool(std::min(config_.analysis_threads, resolutions_.size() - 1)));
+        }
+        running_ = true;
+        worker_ = std::thread(&analyser_stream::analysis_thread, this);
     }
+}
 
+analyser_stream::~analyser_stream() {
+    if(worker_.joinable()) {
+        {
+            std::unique_lock<std::mutex> lock(tap_mtx_);
+            running_ = false;
+        }
+        tap_cv_.notify_one();
+        worker_.join();
+    }
+    finish_recording();
+}
 
-    for(int i = 0; i != bins_; ++i) {
-        const auto idx = 2*i;
-        float mag = 20.f * std::log10(inv_transform_size
-                                      * std::sqrt(transform_buffer_[idx] * transform_buffer_[idx]
-                                                  + transform_buffer_[idx+1] * transform_buffer_[idx+1]));
-        for(int k = 4; k != 0; --k) smoothing_[5*i+k] = smoothing_[5*i+(k-1)];
-        smoothing_[5*i] = mag; mag = 0;
-        for(int k = 0; k != 5; ++k) mag += tri_smooth[k]*smoothing_[5*i+k];
-        mag *= inv_tri;
-        curr_bin_buffer_[i] = (zap::maths::clamp(mag, -100.f, 0.f) + 100.f)*0.01f;
+std::vector<float> analyser_stream::band_centres() const {
+    std::vector<float> centres;
+    centres.reserve(bins_);
+    for(const auto& res : resolutions_) {
+        for(size_t b = 0; b != res->filters.bands(); ++b) centres.push_back(res->filters.centre_frequency(b));
     }
+    return centres;
+}
+
+size_t analyser_stream::read(buffer_t& buffer, size_t len) {
+    if(!parent()) return 0;
 
+    size_t ret = parent()->read(buffer, len);
+    push(buffer.data(), ret);
     return ret;
 }
 
+void analyser_stream::push(const sample_t* samples, size_t len) {
+    if(mode_ == analysis_mode::AM_TAP) {
+        // Never block the audio thread, if the worker has fallen behind the block is dropped from the analysis
+        const size_t written = tap_ring_.write(samples, len);
+        if(written < len) dropped_samples_.fetch_add(len - written, std::memory_order_relaxed);
+        if(tap_ring_.read_available() >= stft_.channels()*stft_.hop_size()) tap_cv_.notify_one();
+        return;
+    }
+
+    analyse_block(samples, len);
+}
+
 size_t analyser_stream::write(const buffer_t& buffer, size_t len) {
     return 0;
 }
 
-void analyser_stream::process_samples(const buffer_t& samples) {
-    const size_t sample_count = frame_size_*2;
-    const size_t fft_window = 2 * sample_count;
-    if(transform_buffer_.size() < fft_window) transform_buffer_.resize(fft_window);
+void analyser_stream::analysis_thread() {
+    const size_t hop = stft_.channels()*stft_.hop_size();
+    while(running_) {
+        {
+            // The timeout bounds the latency of a notification lost between the check and the wait
+            std::unique_lock<std::mutex> lock(tap_mtx_);
+            tap_cv_.wait_for(lock, std::chrono::milliseconds(10), [this, hop]() {
+                return !running_ || tap_ring_.read_available() >= hop;
+            });
+        }
+
+        while(running_ && tap_ring_.read_available() != 0) {
+            const size_t len = tap_ring_.read(tap_block_.data(), tap_block_.size());
+            analyse_block(tap_block_.data(), len);
+        }
+    }
+}
+
+void analyser_stream::analyse_block(const sample_t* samples, size_t len) {
+    size_t offset = 0;
+    while(offset != len) {
+        offset += stft_.push(samples + offset, len - offset);
+        if(stft_.frame_ready()) analyse_frame();
+    }
+}
+
+void analyser_stream::analyse_frame() {
+    // Samples dropped from the tap ring never reach the stft but were still played
+    const int64_t end = int64_t(stft_.position()) +
+                        int64_t(dropped_samples_.load(std::memory_order_relaxed)/stft_.channels());
+    update_track(end);
+
+    auto& frame = bin_frames_.back();
+    frame.position = end - int64_t(stft_.fft_size()/2);
+
+    if(!cached_frame(frame)) {
+        if(pool_) pool_->run(resolutions_.size(), resolution_task_);
+        else      for(size_t i = 0; i != resolutions_.size(); ++i) analyse_resolution(i);
+
+        analyser_.process(bands_.data(), bins_);
+        smoother_.process(bands_.data(), bands_.data());
 
-    for(size_t i = 0; i < sample_count; ++i) {
-        const auto idx = 2*i;
-        if(i < frame_size_) {
-            transform_buffer_[idx]     = prev_[idx] * hamming_window(i, sample_count);
-            transform_buffer_[idx + 1] = 0;
+        normalise_db(bands_.data(), frame.bins.data(), bins_, config_.min_db, config_.max_db);
+        if(!side_bands_.empty()) {
+            side_smoother_.process(side_bands_.data(), side_bands_.data());
+            normalise_db(side_bands_.data(), frame.side_bins.data(), bins_, config_.min_db, config_.max_db);
+            float width = 0.f;
+            for(const auto& res : resolutions_) width += res->width;
+            frame.width = width/resolutions_.size();
+        }
+        frame.beat = analyser_.beat();
+        frame.pitch = analyser_.pitch();
+    }
+
+    frame.level = 10.f*std::log10(std::max(stft_.mean_square(stft_.hop_size()), level_floor));
+    if(track_key_ != 0) measure_hop(frame.beat);
+    stft_.next_hop();
+
+    if(recording_) {
+        // A gap in the track (dropped samples) would misalign the recording so it is abandoned
+        const int64_t k = track_frame(frame.position);
+        if(k == int64_t(track_features_.frames())) {
+            track_features_.add_frame(frame.bins.data(), side_bands_.empty() ? nullptr : frame.side_bins.data(),
+                                      frame.level, frame.width);
+        } else if(k > int64_t(track_features_.frames())) {
+            recording_ = false;
+        }
+    }
+
+    frame.sequence = ++sequence_;
+    frame.timestamp = frame_clock::now();
+
+    history_.begin_write() = frame;
+    history_.end_write();
+    if(on_frame_) on_frame_(frame);
+    bin_frames_.publish();
+}
+
+void analyser_stream::analyse_resolution(size_t idx) {
+    auto& res = *resolutions_[idx];
+    const size_t N = res.fft.size(), bins = res.fft.bins();
+    // Power normalised so that 10*log10 matches 20*log10 of the magnitude scaled by 1/N
+    const float inv_power = 1.f/(float(N)*N);
+
+    if(config_.stereo == stereo_mode::SM_MONO) {
+        if(res.q15) {
+            const float scale = std::ldexp(s16_inv, transform_q15(res, stft::mix_channels));
+            q15_power_spectrum(res.q15_re.data(), res.q15_im.data(), res.power.data(), bins, scale*scale*inv_power);
+        } else {
+            stft_.extract(res.frame.data(), res.window->data(), N, res.delay);
+            res.fft.forward(res.frame.data(), res.re.data(), res.im.data());
+            power_spectrum(res.re.data(), res.im.data(), res.power.data(), bins, inv_power);
+        }
+    } else {
+        if(res.q15) {
+            // Each channel is transformed on its own, the spectra rejoin the float path for the width and mid/side
+            float scale = std::ldexp(s16_inv, transform_q15(res, 0));
+            q15_to_float(res.q15_re.data(), res.re.data(), bins, scale);
+            q15_to_float(res.q15_im.data(), res.im.data(), bins, scale);
+            scale = std::ldexp(s16_inv, transform_q15(res, 1));
+            q15_to_float(res.q15_re.data(), res.side_re.data(), bins, scale);
+            q15_to_float(res.q15_im.data(), res.side_im.data(), bins, scale);
         } else {
-            const auto offset = idx - sample_count;
-            transform_buffer_[idx]     = s16_inv*samples[offset] * hamming_window(i, sample_count);
-            transform_buffer_[idx + 1] = 0;
-            curr_[offset] = s16_inv*samples[offset];
+            stft_.extract(res.frame.data(), res.window->data(), N, res.delay, 0);
+            stft_.extract(res.side_frame.data(), res.window->data(), N, res.delay, 1);
+            res.pair->forward(res.frame.data(), res.side_frame.data(), res.re.data(), res.im.data(),
+                              res.side_re.data(), res.side_im.data());
+        }
+        res.width = stereo_width(res.re.data(), res.im.data(), res.side_re.data(), res.side_im.data(), bins);
+        if(config_.stereo == stereo_mode::SM_MID_SIDE) {
+            mid_side(res.re.data(), res.im.data(), res.side_re.data(), res.side_im.data(), bins);
         }
+        power_spectrum(res.re.data(), res.im.data(), res.power.data(), bins, inv_power);
+        power_spectrum(res.side_re.data(), res.side_im.data(), res.side_power.data(), bins, inv_power);
+    }
+
+    if(idx == 0) analyser_.process_spectrum(res.power.data(), bins);
+    float* bands = bands_.data() + res.band_offset;
+    res.filters.apply(res.power.data(), bands);
+    power_to_db(bands, bands, res.filters.bands());
+
+    if(!side_bands_.empty()) {
+        float* side = side_bands_.data() + res.band_offset;
+        res.filters.apply(res.side_power.data(), side);
+        power_to_db(side, side, res.filters.bands());
+    }
+}
+
+int analyser_stream::transform_q15(resolution& res, size_t channel) {
+    stft_.extract_s16(res.samples.data(), res.samples.size(), res.delay, channel);
+    return res.q15->forward(res.samples.data(), res.q15_window.data(), res.q15_re.data(), res.q15_im.data());
+}
+
+bool analyser_stream::frame_at(double position, bin_frame& output) {
+    const uint64_t count = history_.count();
+    if(count == 0 || !history_.read(count - 1, newer_)) return false;
+    if(position >= newer_.position) {
+        output = newer_;
+        return true;
+    }
+
+    // Frames are a hop apart which locates the older frame of the pair directly, the oldest slot is skipped as the
+    // producer may already be overwriting it
+    const uint64_t oldest = count > history_.capacity() ? count - history_.capacity() + 1 : 0;
+    const uint64_t steps = uint64_t(std::ceil((newer_.position - position)/stft_.hop_size()));
+    const uint64_t index = count - 1 - std::min(steps, count - 1 - oldest);
+    if(!history_.read(index, older_)) {
+        output = newer_;
+        return true;
     }
 
-    fourier_transform(transform_buffer_, sample_count, false);
-    prev_ = curr_;
+    if(position <= older_.position || (index + 1 != count - 1 && !history_.read(index + 1, newer_))) {
+        output = older_;
+        return true;
+    }
+
+    const float t = float((position - older_.position)/double(newer_.position - older_.position));
+    output = t < .5f ? older_ : newer_;
+    for(size_t i = 0; i != bins_; ++i) output.bins[i] = older_.bins[i] + t*(newer_.bins[i] - older_.bins[i]);
+    for(size_t i = 0; i != output.side_bins.size(); ++i) {
+        output.side_bins[i] = older_.side_bins[i] + t*(newer_.side_bins[i] - older_.side_bins[i]);
+    }
+    output.width = older_.width + t*(newer_.width - older_.width);
+    output.level = older_.level + t*(newer_.level - older_.level);
+    return true;
 }
 
-void analyser_stream::fourier_transform(fft_buffer_t& fft_buffer, int window, bool inverse) {
-    int sign = inverse ? -1 : 1;
-    float wr, wi, arg, temp;
-    int p1, p2;
-    float tr, ti, ur, ui;
-    int p1r, p1i, p2r, p2i;
-    int i, bitm, j, le, le2, k;
-    int fftFrameSize2 = window * 2;
+bool analyser_stream::begin_track(uint64_t start, feature_map_ptr cache, uint64_t key) {
+    track_marker marker{start, std::move(cache), key};
+    if(track_markers_.write(&marker, 1) == 1) return true;
+    LOG_ERR("Too many tracks announced ahead of the analyser, the track will be analysed");
+    return false;
+}
 
-    for(i = 2; i < fftFrameSize2 - 2; i += 2) {
-        for(bitm = 2, j = 0; bitm < fftFrameSize2; bitm <<= 1) {
-            if((i & bitm) != 0) j++;
-            j <<= 1;
+void analyser_stream::update_track(int64_t position) {
+    while(true) {
+        if(!has_next_track_) {
+            if(track_markers_.read(&next_track_, 1) == 0) return;
+            has_next_track_ = true;
         }
-        if(i < j) {
-            p1 = i; p2 = j;
-            temp = fft_buffer[p1];
-            fft_buffer[p1++] = fft_buffer[p2];
-            fft_buffer[p2++] = temp;
-            temp = fft_buffer[p1];
-            fft_buffer[p1] = fft_buffer[p2];
-            fft_buffer[p2] = temp;
+        if(int64_t(next_track_.start) > position) return;
+
+        finish_recording();
+        track_start_ = next_track_.start;
+        track_cache_ = std::move(next_track_.cache);
+        track_key_ = next_track_.key;
+        next_track_.cache.reset();
+        has_next_track_ = false;
+
+        // Measured from the first hop so a partial cache extended later still gets the loudness of the whole track
+        meter_.reset();
+        track_tempo_.clear();
+        track_confidence_.clear();
+
+        // The cache key covers the configuration but a stale or foreign file must not be trusted
+        if(track_cache_ && (track_cache_->bands() != bins_ || track_cache_->hop_size() != stft_.hop_size() ||
+                            track_cache_->has_side_bins() != !side_bands_.empty())) {
+            LOG_ERR("The cached analysis does not match the analyser configuration");
+            track_cache_.reset();
         }
+
+        if(!track_cache_ && track_key_ != 0) start_recording();
     }
+}
+
+int64_t analyser_stream::track_frame(int64_t position) const {
+    // Cached and recorded frames start with the track, frame k ends (k + 1) hops into it
+    const int64_t hop = int64_t(stft_.hop_size());
+    const int64_t end = position + int64_t(stft_.fft_size()/2) - int64_t(track_start_);
+    return end < 0 ? -1 : (end + hop/2)/hop - 1;
+}
+
+bool analyser_stream::cached_frame(bin_frame& frame) {
+    if(!track_cache_) return false;
 
-    int kmax = (int)(std::log(window) / std::log(2.0) + 0.5);
-    for (k = 0, le = 2; k < kmax; k++) {
-        le <<= 1;
-        le2 = le >> 1;
-        ur = 1.0f;
-        ui = 0.0f;
-        arg = (float)(zap::maths::PI / (le2 >> 1));
-        wr = std::cos(arg);
-        wi = sign * std::sin(arg);
-        for (j = 0; j < le2; j += 2) {
-            p1r = j; p1i = p1r + 1;
-            p2r = p1r + le2; p2i = p2r + 1;
-            for (i = j; i < fftFrameSize2; i += le) {
-                float p2rVal = fft_buffer[p2r];
-                float p2iVal = fft_buffer[p2i];
-                tr = p2rVal * ur - p2iVal * ui;
-                ti = p2rVal * ui + p2iVal * ur;
-                fft_buffer[p2r] = fft_buffer[p1r] - tr;
-                fft_buffer[p2i] = fft_buffer[p1i] - ti;
-                fft_buffer[p1r] += tr;
-                fft_buffer[p1i] += ti;
-                p1r += le;
-                p1i += le;
-                p2r += le;
-                p2i += le;
+    const int64_t k = track_frame(frame.position);
+    if(k < 0) return false;
+
+    const auto& cache = *track_cache_;
+    if(size_t(k) >= cache.frames()) {
+        // The cache holds part of the track, carry on analysing and extend the recording from the cached frames
+        if(track_key_ != 0) {
+            start_recording();
+            track_features_.bins.assign(cache.bins(0), cache.bins(0) + cache.frames()*bins_);
+            if(cache.has_side_bins()) {
+                track_features_.side_bins.assign(cache.side_bins(0), cache.side_bins(0) + cache.frames()*bins_);
+            }
+            for(size_t i = 0; i != cache.frames(); ++i) {
+                track_features_.level.push_back(cache.level(i));
+                track_features_.width.push_back(cache.width(i));
             }
-            tr = ur * wr - ui * wi;
-            ui = ur * wi + ui * wr;
-            ur = tr;
         }
+        track_cache_.reset();
+        return false;
+    }
+
+    constexpr float inv_quantum = 1.f/255.f;
+    const uint8_t* bins = cache.bins(size_t(k));
+    for(size_t b = 0; b != bins_; ++b) frame.bins[b] = bins[b]*inv_quantum;
+    if(cache.has_side_bins()) {
+        const uint8_t* side = cache.side_bins(size_t(k));
+        for(size_t b = 0; b != bins_; ++b) frame.side_bins[b] = side[b]*inv_quantum;
+    }
+    frame.width = cache.width(size_t(k));
+
+    // The beat tracker keeps running on the cached bands, the pitch needs the spectrum and is not cached
+    const float db_range = config_.max_db - config_.min_db;
+    for(size_t b = 0; b != bins_; ++b) bands_[b] = config_.min_db + frame.bins[b]*db_range;
+    analyser_.process(bands_.data(), bins_);
+    frame.beat = analyser_.beat();
+    frame.pitch = pitch_state{0.f, 0.f};
+    return true;
+}
+
+void analyser_stream::start_recording() {
+    track_features_ = track_features();
+    track_features_.sample_rate = uint32_t(config_.sample_rate);
+    track_features_.hop_size = uint32_t(stft_.hop_size());
+    track_features_.bands = uint32_t(bins_);
+    track_features_.min_db = config_.min_db;
+    track_features_.max_db = config_.max_db;
+    track_features_.centres = band_centres();
+    recording_ = true;
+}
+
+// Feeds the hop completing the current frame to the loudness meter and keeps the frame's tempo estimate
+void analyser_stream::measure_hop(const beat_state& beat) {
+    const size_t hop = stft_.hop_size(), channels = stft_.channels();
+    for(size_t c = 0; c != channels; ++c) {
+        stft_.extract_s16(hop_channel_.data(), hop, 0, c);
+        for(size_t i = 0; i != hop; ++i) hop_samples_[i*channels + c] = hop_channel_[i];
+    }
+    meter_.process(hop_samples_.data(), hop);
+
+    if(beat.bpm > 0.f) {
+        track_tempo_.push_back(beat.bpm);
+        track_confidence_.push_back(beat.confidence);
+    }
+}
+
+static float median(std::vector<float>& values) {
+    if(values.empty()) return 0.f;
+    auto mid = values.begin() + values.size()/2;
+    std::nth_element(values.begin(), mid, values.end());
+    return *mid;
+}
+
+void analyser_stream::finish_recording() {
+    if(!recording_) return;
+    recording_ = false;
+
+    auto& features = track_features_;
+    const size_t frames = features.frames();
+    if(frames == 0 || !on_track_analysed_) return;
+
+    // Mean power per band over the track from the quantised bins
+    const float db_range = features.max_db - features.min_db;
+    features.energy.assign(features.bands, 0.f);
+    std::vector<double> energy(features.bands, 0.);
+    for(size_t f = 0; f != frames; ++f) {
+        const uint8_t* bins = features.frame(f);
+        for(size_t b = 0; b != features.bands; ++b) {
+            energy[b] += std::pow(10., (features.min_db + bins[b]/255.*db_range)/10.);
+        }
+    }
+    for(size_t b = 0; b != features.bands; ++b) {
+        features.energy[b] = float(10.*std::log10(std::max(energy[b]/frames, double(level_floor))));
     }
-}
\ No newline at end of file
+
+    // The tracker's state at the end only reflects the last few seconds, the median follows the whole track
+    features.loudness = meter_.integrated();
+    features.true_peak = meter_.true_peak();
+    features.bpm = median(track_tempo_);
+    features.beat_confidence = median(track_confidence_);
+
+    on_track_analysed_(track_key_, std::move(track_features_));
+    track_features_ = track_features();
+}
@@ -4,52 +4,284 @@
 
 /*
  * Implements the spectral analyser stream.  The stream is plugged into the playback stream just before the data
- * is sent to the audio device.  This allows the current frame to be synced with the FFT for that frame.  It may be
- * necessary to build a delay line to sync the FFT with the audio output as the output may be a frame or two behind.
+ * is sent to the audio device.  The output lags the analysis by the device latency so every frame is stamped with
+ * the sample position at its centre and a short history is kept, frame_at() picks or interpolates the frame for the
+ * position a playback_clock reports as audible.  A float playback chain instead passes its blocks through an
+ * analyser_tap, which hands an s16 copy of each to push().
+ *
+ * Frames of fft_size samples are taken from a circular history every hop_size samples (see stft) so any overlap
+ * can be used with whatever block length the device pulls.
+ *
+ * Several resolutions may be analysed from the same history, for example a long FFT for the bass and a short one
+ * for the treble.  Each resolution covers its own frequency range and fills a consecutive run of the published bins,
+ * the shorter frames are centred on the longest so all bands describe the same instant.  In AM_TAP mode the
+ * resolutions are spread over a worker pool of analysis_threads threads.
+ *
+ * Stereo sources are analysed as the mono mix by default.  SM_LEFT_RIGHT and SM_MID_SIDE transform both channels
+ * with one packed complex FFT and publish a second set of bands with the stereo width, the beat and pitch follow the
+ * primary (left or mid) bands.
+ *
+ * FA_Q15 replaces the windowing and FFT with the fixed-point q15_real_fft working directly on the s16 history, for CPUs
+ * with poor float throughput.  The mono power spectrum is formed in integers, the stereo spectra are converted to
+ * float for the width and mid/side.  The bands and bins match FA_FLOAT down to a noise floor 60 to 75 dB below the
+ * loudest bin of each frame.
+ *
+ * A track announced with begin_track() and a cached feature_map is served from the cache instead of being analysed,
+ * only the beat tracker still runs.  A track announced with a key but no cache is recorded and handed to
+ * on_track_analysed() when the next track begins, a cache covering only part of a track is extended the same way.
+ * Every hop of such a track also passes through an R128 loudness_meter, the recording's loudness is the integrated
+ * loudness and true peak of the whole track and its tempo the median of the beat tracker's estimates.
+ * Cache maps are released on the analysing thread so caching is intended for AM_TAP mode.
+ *
+ * In AM_INLINE mode the analysis is performed in read() on the calling (audio) thread.  In AM_TAP mode read() only
+ * copies the block into a lock-free ring and returns, a dedicated analysis thread drains the ring and publishes bins.
+ *
+ * Bins are published through a wait-free triple buffer so the producer never waits on a reader.  copy_bins(),
+ * copy_frame() and frame_at() may only be called from a single consumer thread (the GUI thread).
  */
 
 #include <zapAudio/streams/audio_stream.hpp>
 #include <zap/maths/maths.hpp>
 #include <mutex>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+#include "dsp/fft.hpp"
+#include "dsp/fft_q15.hpp"
+#include "dsp/stft.hpp"
+#include "dsp/window.hpp"
+#include "dsp/filter_bank.hpp"
+#include "dsp/spectrum_ops.hpp"
+#include "dsp/spsc_ring.hpp"
+#include "dsp/triple_buffer.hpp"
+#include "dsp/seqlock_ring.hpp"
+#include "dsp/worker_pool.hpp"
+#include "dsp/loudness_meter.hpp"
+#include "analyser.hpp"
+#include "feature_file.hpp"
+
+enum class analysis_mode {
+    AM_INLINE,
+    AM_TAP
+};
+
+enum class stereo_mode {
+    SM_MONO,                // The mix of all channels
+    SM_LEFT_RIGHT,
+    SM_MID_SIDE
+};
+
+enum class fft_arithmetic {
+    FA_FLOAT,
+    FA_Q15                  // Fixed-point transforms on the s16 samples
+};
+
+struct resolution_config {
+    size_t fft_size;
+    size_t bins;
+    float min_frequency;
+    float max_frequency;
+};
+
+struct analyser_config {
+    size_t sample_rate = 44100;
+    size_t channels = 2;
+    size_t fft_size = 1024;
+    size_t hop_size = 512;
+    size_t bins = 128;                              // Number of output bands
+    band_scale scale = band_scale::BS_LOG;
+    float min_frequency = 30.f;
+    float max_frequency = 16000.f;
+    window_type window = window_type::WT_HANN;
+    float attack_time = 0.f;                        // Smoothing time constants in seconds, 0 follows immediately
+    float release_time = 0.f;
+    pitch_method pitch = pitch_method::PM_NONE;
+    float min_pitch = 50.f;                         // Pitch search range in Hz
+    float max_pitch = 1000.f;
+    float min_db = -100.f;                          // The dB range mapped onto [0, 1] in the published bins
+    float max_db = 0.f;
+    analysis_mode mode = analysis_mode::AM_INLINE;
+    stereo_mode stereo = stereo_mode::SM_MONO;     // Stereo modes require two channels
+    std::vector<resolution_config> resolutions;     // If not empty, replaces fft_size, bins, min and max_frequency
+    size_t analysis_threads = 0;                    // Pool threads used for multiple resolutions in AM_TAP mode
+    fft_arithmetic arithmetic = fft_arithmetic::FA_FLOAT;
+};
 
 class analyser_stream : public audio_stream<short> {
 public:
     using sample_t = short;
     using buffer_t = typename audio_stream<sample_t>::buffer_t;
     using fft_buffer_t = std::vector<float>;
+    using q15_buffer_t = std::vector<int16_t>;
+    using frame_clock = std::chrono::steady_clock;
+
+    struct bin_frame {
+        uint64_t sequence;                  // Incremented for every published frame, 0 before the first
+        frame_clock::time_point timestamp;  // When the frame was published
+        int64_t position;                   // Sample frame at the centre of the analysis window
+        fft_buffer_t bins;                  // Mono, left or mid bands
+        fft_buffer_t side_bins;             // Right or side bands, empty in SM_MONO
+        float width;                        // Stereo width in [0, 1], see stereo_width()
+        float level;                        // Mean square level of the latest hop in dBFS
+        beat_state beat;
+        pitch_state pitch;
+    };
 
-    analyser_stream(audio_stream<sample_t>* parent, size_t frame_size=512, size_t bins=128);
-    virtual ~analyser_stream() = default;
+    analyser_stream(audio_stream<sample_t>* parent, const analyser_config& config=analyser_config());
+    virtual ~analyser_stream();
 
     virtual size_t read(buffer_t& buffer, size_t len);
     virtual size_t write(const buffer_t& buffer, size_t len);
 
+    // Analyses len samples as read() does with the samples it reads, for an analyser fed by an analyser_tap instead
+    // of its parent.  Called from one thread, the audio thread.
+    void push(const sample_t* samples, size_t len);
+
     size_t copy_bins(fft_buffer_t& output, size_t bins) {
-        std::unique_lock<std::mutex> lock(bin_buffer_mtx_);
+        const auto& frame = latest_frame();
         size_t size = std::min(bins_, bins);
         if(output.size() != bins) output.resize(bins);
-        std::copy(prev_bin_buffer_.begin(), prev_bin_buffer_.begin()+size, output.begin());
+        std::copy(frame.bins.begin(), frame.bins.begin()+size, output.begin());
         return size;
     }
 
+    // Copies the latest complete frame into output unless output already holds it, returns the frame's sequence
+    uint64_t copy_frame(bin_frame& output) {
+        const auto& frame = latest_frame();
+        if(frame.sequence != output.sequence) output = frame;
+        return frame.sequence;
+    }
+
+    // Writes the frame for the sample frame position, interpolating the bins between the two nearest frames in the
+    // history.  Positions outside the history return the oldest or newest frame, returns false before the first.
+    bool frame_at(double position, bin_frame& output);
+
+    // Called on the analysing thread with every frame as it is published, used by offline analysis to see every frame
+    void on_frame(std::function<void(const bin_frame&)>&& callback_fnc) { on_frame_ = std::move(callback_fnc); }
+
+    using feature_map_ptr = std::shared_ptr<const feature_map>;
+    using track_fnc = std::function<void(uint64_t key, track_features&& features)>;
+
+    // Announces a track starting at sample frame start of the stream, cache may be null.  A key of 0 disables
+    // recording.  May be called from one thread at a time, ahead of the audio reaching the analyser.
+    bool begin_track(uint64_t start, feature_map_ptr cache, uint64_t key=0);
+
+    // Called on the analysing thread with the frames recorded for a track
+    void on_track_analysed(track_fnc&& callback_fnc) { on_track_analysed_ = std::move(callback_fnc); }
+
+    const analyser_config& config() const { return config_; }
+    size_t bins() const { return bins_; }
+    size_t fft_size() const { return resolutions_.front()->fft.size(); }
+    size_t resolutions() const { return resolutions_.size(); }
+    // The centre frequency in Hz of each published band
+    std::vector<float> band_centres() const;
+    size_t hop_size() const { return stft_.hop_size(); }
+    analysis_mode get_mode() const { return mode_; }
+    stereo_mode get_stereo_mode() const { return config_.stereo; }
+    size_t dropped_samples() const { return dropped_samples_.load(std::memory_order_relaxed); }
+
 protected:
-    void process_samples(const  buffer_t& samples);
+    void analyse_block(const sample_t* samples, size_t len);
+    void analyse_frame();
+    void analyse_resolution(size_t idx);
+    void update_track(int64_t position);
+    int64_t track_frame(int64_t position) const;
+    bool cached_frame(bin_frame& frame);
+    void start_recording();
+    void finish_recording();
+    void measure_hop(const beat_state& beat);
+    void analysis_thread();
 
-    inline float hamming_window(size_t n, size_t N) {
-        return 0.54f - 0.46f * std::sin(2.0f * (float)zap::maths::TWO_PI * n)/(N - 1);
+    const bin_frame& latest_frame() {
+        bin_frames_.update();
+        return bin_frames_.front();
     }
 
-    size_t frame_size_;
+    // One FFT size and the bands it produces, each resolution owns its buffers so they may run concurrently
+    struct resolution {
+        resolution(const resolution_config& config, const analyser_config& analyser, size_t delay,
+                   size_t band_offset);
+
+        real_fft fft;
+        std::unique_ptr<stereo_fft> pair;   // Both channels in one transform, stereo modes only
+        window_table_ptr window;
+        filter_bank filters;
+        size_t delay;                       // Samples between the end of this frame and the newest sample
+        size_t band_offset;                 // First band written by this resolution
+        fft_buffer_t frame;
+        fft_buffer_t re;
+        fft_buffer_t im;
+        fft_buffer_t power;
+        fft_buffer_t side_frame;            // The second channel's buffers, stereo modes only
+        fft_buffer_t side_re;
+        fft_buffer_t side_im;
+        fft_buffer_t side_power;
+        float width;
+        std::unique_ptr<q15_real_fft> q15;  // FA_Q15 only
+        q15_buffer_t q15_window;
+        q15_buffer_t q15_re;
+        q15_buffer_t q15_im;
+        buffer_t samples;
+    };
+
+    using resolution_ptr = std::unique_ptr<resolution>;
+    static std::vector<resolution_ptr> make_resolutions(const analyser_config& config);
+
+    // Transforms channel into the resolution's Q15 spectrum, returns its exponent
+    int transform_q15(resolution& res, size_t channel);
+
+    analyser_config config_;
+    std::vector<resolution_ptr> resolutions_;
+    stft stft_;
     size_t bins_;
-    fft_buffer_t transform_buffer_;
-    fft_buffer_t prev_bin_buffer_;
-    fft_buffer_t curr_bin_buffer_;
-    std::mutex bin_buffer_mtx_;
-    fft_buffer_t prev_;
-    fft_buffer_t curr_;
-    fft_buffer_t smoothing_;
-
-    void fourier_transform(fft_buffer_t& fft_buffer, int window, bool inverse);
+    fft_buffer_t bands_;
+    fft_buffer_t side_bands_;
+    triple_buffer<bin_frame> bin_frames_;
+    seqlock_ring<bin_frame> history_;
+    bin_frame older_;                       // Scratch frames for frame_at(), consumer side
+    bin_frame newer_;
+    uint64_t sequence_;
+    spectral_smoother smoother_;
+    spectral_smoother side_smoother_;
+    analyser analyser_;
+    std::function<void(const bin_frame&)> on_frame_;
+
+    struct track_marker {
+        uint64_t start;
+        feature_map_ptr cache;
+        uint64_t key;
+    };
+
+    spsc_ring<track_marker> track_markers_;
+    track_marker next_track_;
+    bool has_next_track_;
+    uint64_t track_start_;
+    feature_map_ptr track_cache_;
+    uint64_t track_key_;
+    bool recording_;
+    track_features track_features_;
+    loudness_meter meter_;                  // The loudness of the track being recorded, from its first hop
+    buffer_t hop_samples_;                  // The interleaved samples of a hop for meter_
+    buffer_t hop_channel_;
+    std::vector<float> track_tempo_;        // The beat tracker's estimates over the track
+    std::vector<float> track_confidence_;
+    track_fnc on_track_analysed_;
+    std::unique_ptr<worker_pool> pool_;
+    worker_pool::task_fnc resolution_task_;
+
+    analysis_mode mode_;
+    spsc_ring<sample_t> tap_ring_;
+    std::vector<sample_t> tap_block_;
+    std::atomic<bool> running_;
+    std::atomic<size_t> dropped_samples_;
+    std::mutex tap_mtx_;
+    std::condition_variable tap_cv_;
+    std::thread worker_;
 
 private:
 
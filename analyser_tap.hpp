@@ -0,0 +1,49 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_ANALYSER_TAP_HPP
+#define ZAPPLAYER_ANALYSER_TAP_HPP
+
+/*
+ * Plugs an analyser_stream into a float pipeline.  Every block passes through unchanged while a copy is converted to
+ * s16 in chunks of up to max_frames frames and pushed to the analyser, whose transforms and Q15 path work on s16.  The
+ * copy is only observed, the rounding never reaches the output.
+ */
+
+#include <zapAudio/streams/audio_stream.hpp>
+#include <vector>
+#include <algorithm>
+#include "analyser_stream.hpp"
+#include "dsp/sample_ops.hpp"
+
+class analyser_tap : public audio_stream<float> {
+public:
+    using stream_t = audio_stream<float>;
+    using buffer_t = typename stream_t::buffer_t;
+
+    analyser_tap(stream_t* input, analyser_stream* analyser, size_t channels, size_t max_frames=1024) :
+        stream_t(input), analyser_(analyser), scratch_(max_frames*channels) {
+    }
+
+    analyser_stream* analyser() const { return analyser_; }
+
+    virtual size_t read(buffer_t& buffer, size_t len) {
+        if(!this->parent()) return 0;
+
+        auto ret = this->parent()->read(buffer, len);
+        for(size_t i = 0; i < ret; i += scratch_.size()) {
+            const size_t count = std::min(scratch_.size(), ret - i);
+            float_to_s16(buffer.data() + i, scratch_.data(), count, 32768.f);
+            analyser_->push(scratch_.data(), count);
+        }
+        return ret;
+    }
+
+    virtual size_t write(const buffer_t& buffer, size_t len) {
+        return 0;
+    }
+
+protected:
+    analyser_stream* analyser_;
+    std::vector<short> scratch_;
+};
+
+#endif //ZAPPLAYER_ANALYSER_TAP_HPP
@@ -5,8 +5,24 @@
 #ifndef ZAPPLAYER_CONTROLLER_STREAM_HPP
 #define ZAPPLAYER_CONTROLLER_STREAM_HPP
 
+/*
+ * The last stage before the device (or before the dither_stream ending a float pipeline), applies the volume, pan
+ * and per-channel gains.  The parameters are atomics that any thread may set without locking, the audio thread reads
+ * them once per block and ramps every channel's gain linearly from its value at the end of the previous block so
+ * changes never step (zipper).  s16 blocks are scaled by the saturating gain_ramp_s16 kernel, float blocks by
+ * gain_ramp.
+ *
+ * Pan is a balance control: the centre leaves both channels at unity and moving off centre attenuates the far channel
+ * linearly, it only applies to stereo.
+ */
+
 #include <zapAudio/streams/audio_stream.hpp>
 #include <zap/maths/maths.hpp>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include "dsp/sample_ops.hpp"
+#include "dsp/playback_clock.hpp"
 
 template <typename SampleT>
 class controller_stream : public audio_stream<SampleT> {
@@ -14,17 +30,42 @@ public:
     using stream_t = audio_stream<SampleT>;
     using buffer_t = typename stream_t::buffer_t;
 
+    constexpr static float max_channel_gain = 4.f;     // +12 dB
+
     controller_stream(stream_t* input, size_t sample_rate, size_t channels, size_t frame_size) : stream_t(input),
-        volume_(.75f), sample_rate_(sample_rate), channels_(channels), frame_size_(frame_size) { }
+        volume_(.75f), pan_(0.f), channel_gains_(channels), sample_rate_(sample_rate), channels_(channels),
+        frame_size_(frame_size), clock_(nullptr), start_gains_(channels), end_gains_(channels) {
+        for(auto& g : channel_gains_) g.store(1.f, std::memory_order_relaxed);
+        target_gains(start_gains_.data());
+    }
 
-    void set_volume(float v) { volume_ = zap::maths::clamp(v, 0.f, 1.f); }
-    float get_volume(float v) const { return volume_; }
+    void set_volume(float v) { volume_.store(zap::maths::clamp(v, 0.f, 1.f), std::memory_order_relaxed); }
+    float get_volume() const { return volume_.load(std::memory_order_relaxed); }
+
+    // -1 is hard left, 0 the centre and 1 hard right
+    void set_pan(float p) { pan_.store(zap::maths::clamp(p, -1.f, 1.f), std::memory_order_relaxed); }
+    float get_pan() const { return pan_.load(std::memory_order_relaxed); }
+
+    // A linear gain in [0, max_channel_gain] applied to one channel on top of the volume and pan
+    void set_channel_gain(size_t channel, float gain) {
+        if(channel < channels_) {
+            channel_gains_[channel].store(zap::maths::clamp(gain, 0.f, max_channel_gain), std::memory_order_relaxed);
+        }
+    }
+    float get_channel_gain(size_t channel) const {
+        return channel < channels_ ? channel_gains_[channel].load(std::memory_order_relaxed) : 0.f;
+    }
+
+    // The controller is the last stage before the device, every block it delivers advances the clock
+    void set_clock(playback_clock* clock) { clock_ = clock; }
 
     virtual size_t read(buffer_t& buffer, size_t len) {
         auto ret = this->parent()->read(buffer, len);
-        for(int i = 0; i != len; ++i) {
-            buffer[i] = (SampleT)(std::round(buffer[i] * volume_));
-        }
+        const size_t frames = ret/channels_;
+        target_gains(end_gains_.data());
+        apply_gains(buffer.data(), frames);
+        std::copy(end_gains_.begin(), end_gains_.end(), start_gains_.begin());
+        if(clock_) clock_->advance(frames);
         return ret;
     }
 
@@ -33,10 +74,45 @@ public:
     }
 
 private:
-    float volume_;
+    void target_gains(float* gains) const {
+        const float volume = volume_.load(std::memory_order_relaxed);
+        for(size_t c = 0; c != channels_; ++c) gains[c] = volume * channel_gains_[c].load(std::memory_order_relaxed);
+        if(channels_ == 2) {
+            const float pan = pan_.load(std::memory_order_relaxed);
+            gains[0] *= std::min(1.f, 1.f - pan);
+            gains[1] *= std::min(1.f, 1.f + pan);
+        }
+    }
+
+    void apply_gains(short* samples, size_t frames) {
+        gain_ramp_s16(samples, channels_, frames, start_gains_.data(), end_gains_.data());
+    }
+
+    void apply_gains(float* samples, size_t frames) {
+        gain_ramp(samples, channels_, frames, start_gains_.data(), end_gains_.data());
+    }
+
+    template <typename T>
+    void apply_gains(T* samples, size_t frames) {
+        const float inv = frames > 1 ? 1.f/(frames - 1) : 0.f;
+        for(size_t c = 0; c != channels_; ++c) {
+            const float step = (end_gains_[c] - start_gains_[c])*inv;
+            for(size_t i = 0; i != frames; ++i) samples[i*channels_ + c] *= start_gains_[c] + step*i;
+        }
+    }
+
+    std::atomic<float> volume_;
+    std::atomic<float> pan_;
+    std::vector<std::atomic<float>> channel_gains_;
     size_t sample_rate_;
     size_t channels_;
     size_t frame_size_;
+    playback_clock* clock_;
+    std::vector<float> start_gains_;        // The gains reached at the end of the last block, audio thread only
+    std::vector<float> end_gains_;
 };
 
+template <typename SampleT>
+constexpr float controller_stream<SampleT>::max_channel_gain;
+
 #endif //ZAPPLAYER_CONTROLLER_STREAM_HPP
@@ -1,10 +1,39 @@
 /* Created by Darren Otgaar on 2016/11/24. http://www.github.com/otgaard/zap */
 #include "directory_stream.hpp"
+#include "mp3_probe.hpp"
+#include "dsp/sample_ops.hpp"
 #include "tools/os.hpp"
+#include <cmath>
 #include <regex>
+#include <chrono>
+#include <algorithm>
 #define LOGGING_ENABLED
 #include <tools/log.hpp>
 
+constexpr static size_t directory_channels = 2;
+constexpr static double directory_pi = 3.14159265358979323846;
+
+constexpr size_t directory_stream::preroll_frames;
+constexpr size_t directory_stream::trim_window;
+
+directory_stream::~directory_stream() {
+    if(worker_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(decode_mtx_);
+            running_ = false;
+        }
+        decode_cv_.notify_one();
+        worker_.join();
+    }
+}
+
+void directory_stream::set_crossfade(float seconds, crossfade_curve curve, float trim_seconds, float silence_db) {
+    crossfade_frames_ = size_t(std::max(seconds, 0.f)*output_rate_);
+    trim_frames_ = size_t(std::max(trim_seconds, 0.f)*output_rate_);
+    silence_level_ = std::pow(10.f, silence_db/10.f);
+    curve_ = curve;
+}
+
 bool directory_stream::start() {
     static const std::regex mp3_substr(".mp3$|.MP3$");
     auto files = zap::get_files(path_);
@@ -13,53 +42,226 @@ bool directory_stream::start() {
         file_queue_.push(file);
     }
 
-    if(file_queue_.size() > 1) {
-        file_streams_[0] = std::make_unique<mp3_stream>(file_queue_.front(), frame_size_, nullptr);
-        file_streams_[0]->start();
-        file_queue_.pop();
+    // The preroll covers the leading silence and the crossfade, the queue holds back the trailing silence and the
+    // crossfade with room for a block on top.  Compacting the queue when it fills moves every sample about once more.
+    const size_t preroll = std::max(preroll_frames, crossfade_frames_ + trim_frames_ + frame_size_);
+    current_.preroll.resize(preroll*directory_channels);
+    next_.preroll.resize(preroll*directory_channels);
+    queue_.resize(2*(crossfade_frames_ + trim_frames_ + 2*frame_size_)*directory_channels);
+    scratch_.resize(frame_size_*directory_channels);
+    decode_scratch_.resize(frame_size_*directory_channels);
 
-        if(on_next_track_) on_next_track_(file_streams_[0]->get_filename());
+    fade_out_.resize(crossfade_frames_);
+    fade_in_.resize(crossfade_frames_);
+    from_gains_.resize(crossfade_frames_);
+    to_gains_.resize(crossfade_frames_);
+    for(size_t f = 0; f != crossfade_frames_; ++f) {
+        const double t = (f + .5)/crossfade_frames_;
+        switch(curve_) {
+            case crossfade_curve::CC_LINEAR:
+                fade_in_[f] = float(t);
+                fade_out_[f] = float(1. - t);
+                break;
+            case crossfade_curve::CC_EQUAL_POWER:
+                fade_in_[f] = float(std::sin(.5*directory_pi*t));
+                fade_out_[f] = float(std::cos(.5*directory_pi*t));
+                break;
+            case crossfade_curve::CC_S_CURVE:
+                fade_in_[f] = float(.5 - .5*std::cos(directory_pi*t));
+                fade_out_[f] = 1.f - fade_in_[f];
+                break;
+        }
     }
 
-    if(file_queue_.size() > 1) {
-        file_streams_[1] = std::make_unique<mp3_stream>(file_queue_.front(), frame_size_, nullptr);
-        file_streams_[1]->start();
+    // The decode thread prepares every track, the first included, and read() splices the first in as it would the next
+    running_ = true;
+    worker_ = std::thread(&directory_stream::decode_thread, this);
+    return true;
+}
+
+bool directory_stream::open_track(track& t) {
+    // A file that cannot be decoded is skipped rather than played as an empty track
+    while(!file_queue_.empty()) {
+        t.filename = file_queue_.front();
         file_queue_.pop();
+        t.decoder = std::make_unique<mp3_stream>(t.filename, frame_size_, nullptr);
+        if(t.decoder->start()) break;
+
+        LOG_ERR("Failed to start decoding", t.filename, "skipping it");
+        close_track(t);
+    }
+    if(!t.decoder) return false;
+
+    if(cache_) t.features = cache_->lookup(t.filename, t.key);
+
+    mp3_format format;
+    if(probe_mp3(t.filename, format) && format.sample_rate != output_rate_) {
+        LOG("Resampling", t.filename, "from", format.sample_rate, "Hz");
+        t.source = std::make_unique<resampler_stream>(t.decoder.get(), format.sample_rate, output_rate_,
+                                                      directory_channels, frame_size_);
+    } else {
+        t.source = std::make_unique<float_stream>(t.decoder.get(), directory_channels, frame_size_);
+    }
+
+    // Decode the start of the track so the splice only copies
+    t.preroll_head = 0;
+    t.preroll_size = 0;
+    while(t.preroll_size < t.preroll.size()) {
+        const size_t count = std::min(decode_scratch_.size(), t.preroll.size() - t.preroll_size);
+        const size_t ret = t.stream()->read(decode_scratch_, count);
+        std::copy(decode_scratch_.begin(), decode_scratch_.begin() + ret, t.preroll.begin() + t.preroll_size);
+        t.preroll_size += ret;
+        if(ret < count) break;
     }
 
+    // Skip the leading silence, a block at a time
+    const size_t window = trim_window*directory_channels;
+    const size_t limit = std::min(t.preroll_size, trim_frames_*directory_channels);
+    while(t.preroll_head + window <= limit &&
+          mean_square(t.preroll.data() + t.preroll_head, window) < silence_level_) {
+        t.preroll_head += window;
+    }
     return true;
 }
 
-size_t directory_stream::read(buffer_t& buffer, size_t len) {
-    if(file_streams_[0]) {
-        auto ret = file_streams_[0]->read(buffer, len);
+void directory_stream::close_track(track& t) {
+    t.source.reset();
+    t.decoder.reset();
+    t.filename.clear();
+    t.features.reset();
+    t.key = 0;
+    t.preroll_head = t.preroll_size = 0;
+}
+
+void directory_stream::decode_thread() {
+    while(running_) {
+        {
+            // The timeout bounds the latency of a notification lost between the check and the wait
+            std::unique_lock<std::mutex> lock(decode_mtx_);
+            decode_cv_.wait_for(lock, std::chrono::milliseconds(10), [this]() {
+                return !running_ || (!next_ready_.load(std::memory_order_acquire) && !finished_);
+            });
+        }
+        if(!running_ || next_ready_.load(std::memory_order_acquire) || finished_) continue;
+
+        close_track(next_);
+        if(!open_track(next_)) {
+            finished_ = true;
+            continue;
+        }
+        next_ready_.store(true, std::memory_order_release);
+    }
+}
+
+size_t directory_stream::read_track(track& t, float* output, size_t len) {
+    size_t ret = std::min(len, t.preroll_size - t.preroll_head);
+    std::copy(t.preroll.begin() + t.preroll_head, t.preroll.begin() + t.preroll_head + ret, output);
+    t.preroll_head += ret;
+
+    while(ret < len) {
+        const size_t count = std::min(len - ret, scratch_.size());
+        const size_t read = t.stream()->read(scratch_, count);
+        std::copy(scratch_.begin(), scratch_.begin() + read, output + ret);
+        ret += read;
+        if(read < count) break;
+    }
+    return ret;
+}
 
-        if(skip_track_) {
-            ret = 0;
-            skip_track_ = false;
+void directory_stream::fill_queue() {
+    // Read until a block beyond the held back frames is queued or the track ends
+    const size_t chunk = frame_size_*directory_channels;
+    const size_t target = (crossfade_frames_ + trim_frames_ + frame_size_)*directory_channels;
+    while(queue_tail_ - queue_head_ < target) {
+        if(queue_tail_ + chunk > queue_.size()) {
+            std::copy(queue_.begin() + queue_head_, queue_.begin() + queue_tail_, queue_.begin());
+            queue_tail_ -= queue_head_;
+            queue_head_ = 0;
         }
 
-        if(ret < len) {
-            // This stream is exhausted.  Continue on the next
-            file_streams_[0].swap(file_streams_[1]);
-            std::vector<short> remainder(len - ret);
-            auto rem = file_streams_[0]->read(remainder, len - ret);
+        const size_t count = read_track(current_, queue_.data() + queue_tail_, chunk);
+        queue_tail_ += count;
+        if(count < chunk) {
+            trim_tail();
+            track_ended_ = true;
+            return;
+        }
+    }
+}
 
-            if(on_next_track_) on_next_track_(file_streams_[0]->get_filename());
+void directory_stream::trim_tail() {
+    // Drop the trailing silence a block at a time, back from the end
+    const size_t window = trim_window*directory_channels;
+    const size_t trim = trim_frames_*directory_channels;
+    const size_t limit = std::max(queue_head_, queue_tail_ > trim ? queue_tail_ - trim : 0);
+    while(queue_tail_ >= limit + window &&
+          mean_square(queue_.data() + queue_tail_ - window, window) < silence_level_) {
+        queue_tail_ -= window;
+    }
+}
 
-            if(file_queue_.size() > 1) {
-                file_streams_[1] = std::make_unique<mp3_stream>(file_queue_.front(), frame_size_, nullptr);
-                file_streams_[1]->start();
-                file_queue_.pop();
-            }
+void directory_stream::splice(uint64_t position) {
+    // The overlap is shortened if either track is too short for the full crossfade
+    const size_t frames = std::min({ crossfade_frames_, (queue_tail_ - queue_head_)/directory_channels,
+                                     (next_.preroll_size - next_.preroll_head)/directory_channels });
+    if(frames != 0) {
+        for(size_t f = 0; f != frames; ++f) {
+            const size_t idx = f*crossfade_frames_/frames;
+            from_gains_[f] = fade_out_[idx];
+            to_gains_[f] = fade_in_[idx];
+        }
+        float* tail = queue_.data() + queue_tail_ - frames*directory_channels;
+        crossfade(tail, next_.preroll.data() + next_.preroll_head, tail, directory_channels, frames,
+                  from_gains_.data(), to_gains_.data());
+        next_.preroll_head += frames*directory_channels;
+    }
+
+    std::swap(current_, next_);
+    next_ready_.store(false, std::memory_order_release);
+    decode_cv_.notify_one();
+    track_ended_ = false;
+
+    // The next track is heard from the start of the overlap
+    const uint64_t start = position + (queue_tail_ - queue_head_) - frames*directory_channels;
+    if(on_next_track_) on_next_track_(current_.filename);
+    if(on_track_start_) on_track_start_(current_.filename, start, current_.features, current_.key);
+}
+
+size_t directory_stream::read(buffer_t& buffer, size_t len) {
+    size_t ret = 0;
+    while(ret < len) {
+        if(skip_track_.exchange(false)) {
+            queue_head_ = queue_tail_ = 0;
+            track_ended_ = true;
+        }
+
+        if(!track_ended_) fill_queue();
+        if(track_ended_ && next_ready_.load(std::memory_order_acquire)) {
+            // Fill the queue from the new track before holding back its tail
+            splice(position_ + ret);
+            continue;
+        }
 
-            std::copy(remainder.begin(), remainder.end(), buffer.begin()+ret);
-            return ret + rem;
+        // While the track plays its last frames are held back, they may yet be trimmed or crossfaded
+        const size_t held = track_ended_ ? 0 : (crossfade_frames_ + trim_frames_)*directory_channels;
+        const size_t queued = queue_tail_ - queue_head_;
+        if(queued <= held) {
+            // The track has ended, or none has started, and the next is not ready.  Play silence rather than wait
+            // unless none is left.
+            if(finished_) break;
+            std::fill(buffer.begin() + ret, buffer.begin() + len, 0.f);
+            ret = len;
+            break;
         }
-        return ret;
+
+        const size_t count = std::min(queued - held, len - ret);
+        std::copy(queue_.begin() + queue_head_, queue_.begin() + queue_head_ + count, buffer.begin() + ret);
+        queue_head_ += count;
+        ret += count;
     }
 
-    return 0;
+    position_ += ret;
+    return ret;
 }
 
 size_t directory_stream::write(const buffer_t& buffer, size_t len) {
@@ -71,7 +273,5 @@ std::string directory_stream::current_path() const {
 }
 
 std::string directory_stream::current_track() const {
-    if(file_streams_[0]) return file_streams_[0]->get_filename();
-    else return std::string();
+    return current_.filename;
 }
-
@@ -2,18 +2,74 @@
 #ifndef ZAPPLAYER_DIRECTORY_STREAM_HPP
 #define ZAPPLAYER_DIRECTORY_STREAM_HPP
 
+/*
+ * Plays the files of a directory back to back.  A decode thread opens the next track ahead of time, starts its
+ * decoder, resamples it if needed and decodes the first preroll_frames frames into a buffer allocated at start().
+ * When the current track ends read() only swaps the two tracks and splices the pre-decoded samples onto the end of
+ * the block, so the transition performs no file I/O, decoder construction or allocation.  The finished track is
+ * handed back to the decode thread, which closes it before preparing the one after.
+ *
+ * If the decode thread has not finished preparing the next track when the current one ends (a very slow volume), the
+ * remainder of the block is silence and the splice is retried on the next read rather than waiting.  start() only
+ * lists the directory, the first track is prepared by the decode thread too and spliced in the same way, so the
+ * stream plays silence until it is ready.
+ *
+ * set_crossfade() overlaps consecutive tracks and removes the silence around them.  read() then holds back the last
+ * crossfade plus trim frames of the current track, so when the track ends its tail is still in hand: trailing blocks
+ * quieter than the silence level are dropped, and the last crossfade frames left are mixed sample for sample with the
+ * pre-decoded head of the next track, whose leading silence the decode thread already skipped.  The preroll is
+ * lengthened to cover the crossfade and trim so the overlap is never decoded on the read path.
+ *
+ * With a spectrogram_cache set, opening a track also hashes it and maps its cached frames, which on a network volume
+ * reads the whole file, so that too happens on the decode thread and the splice only hands the result on.
+ *
+ * The stream is float at full scale 1 and starts the float pipeline: each track's decoded samples are converted once,
+ * by its resampler_stream or a float_stream, and the resampling and crossfades never round back to s16.
+ */
+
 #include <array>
 #include <queue>
+#include <mutex>
 #include <string>
 #include <atomic>
 #include <memory>
+#include <thread>
+#include <vector>
 #include <functional>
+#include <condition_variable>
 #include <streams/mp3_stream.hpp>
+#include "float_stream.hpp"
+#include "resampler_stream.hpp"
+#include "spectrogram_cache.hpp"
+
+enum class crossfade_curve {
+    CC_LINEAR,              // Constant amplitude, dips by 3 dB mid-way between uncorrelated tracks
+    CC_EQUAL_POWER,         // Constant power, the usual choice between different tracks
+    CC_S_CURVE              // A raised cosine, gentle at both ends
+};
 
-class directory_stream : public audio_stream<short> {
+class directory_stream : public audio_stream<float> {
 public:
-    directory_stream(const std::string& path, size_t frame_size) : path_(path), frame_size_(frame_size), skip_track_(false) { }
-    virtual ~directory_stream() { }
+    using feature_map_ptr = spectrogram_cache::feature_map_ptr;
+    using track_start_fnc = std::function<void(const std::string&, uint64_t, feature_map_ptr, uint64_t)>;
+
+    constexpr static size_t preroll_frames = 32768;     // Decoded ahead of each track, 0.74 s at 44.1 kHz
+    constexpr static size_t trim_window = 256;          // Frames per RMS block of the silence scan
+
+    // Tracks at other rates than output_rate are resampled to it
+    directory_stream(const std::string& path, size_t frame_size, size_t output_rate=44100) : path_(path),
+        frame_size_(frame_size), output_rate_(output_rate), position_(0), crossfade_frames_(0), trim_frames_(0),
+        silence_level_(0.f), curve_(crossfade_curve::CC_EQUAL_POWER), queue_head_(0), queue_tail_(0),
+        track_ended_(true), cache_(nullptr), skip_track_(false), running_(false), next_ready_(false),
+        finished_(false) { }
+    virtual ~directory_stream();
+
+    // Before start(), overlaps consecutive tracks by seconds (0 cuts between them) and removes up to trim_seconds of
+    // silence from the start and end of every track, silence being RMS blocks below silence_db dBFS
+    void set_crossfade(float seconds, crossfade_curve curve, float trim_seconds=2.f, float silence_db=-60.f);
+
+    // Before start(), every track is looked up in cache as it is opened and the result passed to on_track_start
+    void set_cache(const spectrogram_cache* cache) { cache_ = cache; }
 
     bool start();
 
@@ -28,13 +84,66 @@ public:
         on_next_track_ = std::move(callback_fnc);
     }
 
+    // Called with each track, the number of interleaved samples read before it and the track's cached frames and key
+    // (null and 0 without a cache), as the track is first read
+    void on_track_start(track_start_fnc&& callback_fnc) {
+        on_track_start_ = std::move(callback_fnc);
+    }
+
 private:
+    struct track {
+        std::string filename;
+        std::unique_ptr<mp3_stream> decoder;
+        std::unique_ptr<audio_stream<float>> source;    // A resampler_stream, or a float_stream at output_rate_
+        buffer_t preroll;                               // preroll_frames frames, allocated once
+        size_t preroll_head = 0;                        // The next pre-decoded sample to read
+        size_t preroll_size = 0;
+        feature_map_ptr features;                       // The track's cached frames, null on a miss
+        uint64_t key = 0;
+
+        audio_stream<float>* stream() const { return source.get(); }
+    };
+
+    // Opens the next file in the queue that decodes, false once none is left
+    bool open_track(track& t);
+    void close_track(track& t);
+    size_t read_track(track& t, float* output, size_t len);
+    void fill_queue();
+    void trim_tail();
+    void splice(uint64_t position);
+    void decode_thread();
+
     std::string path_;
     size_t frame_size_;
-    std::queue<std::string> file_queue_;
-    std::array<std::unique_ptr<mp3_stream>, 2> file_streams_;
+    size_t output_rate_;
+    uint64_t position_;                 // Interleaved samples read
+    size_t crossfade_frames_;
+    size_t trim_frames_;
+    float silence_level_;               // Mean square
+    crossfade_curve curve_;
+    std::vector<float> fade_out_;       // The gains of the outgoing and incoming track over crossfade_frames_
+    std::vector<float> fade_in_;
+    std::vector<float> from_gains_;     // fade_out_ and fade_in_ fitted to a shorter overlap
+    std::vector<float> to_gains_;
+    buffer_t queue_;                    // The current track's samples from queue_head_ to queue_tail_
+    size_t queue_head_;
+    size_t queue_tail_;
+    bool track_ended_;                  // The queue holds the end of the current track, or no track has started
+    const spectrogram_cache* cache_;
+    std::queue<std::string> file_queue_;    // Owned by the decode thread after start()
+    track current_;                     // Read by read()
+    track next_;                        // Owned by read() while next_ready_, otherwise by the decode thread
+    buffer_t scratch_;                  // read() only
+    buffer_t decode_scratch_;           // open_track() only
     std::atomic<bool> skip_track_;
+    std::atomic<bool> running_;
+    std::atomic<bool> next_ready_;
+    std::atomic<bool> finished_;        // No tracks are left to prepare
+    std::mutex decode_mtx_;
+    std::condition_variable decode_cv_;
+    std::thread worker_;
     std::function<void(const std::string&)> on_next_track_;
+    track_start_fnc on_track_start_;
 };
 
 #endif //ZAPPLAYER_DIRECTORY_STREAM_HPP
@@ -0,0 +1,68 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#include "convolver.hpp"
+#include "spectrum_ops.hpp"
+#include <cassert>
+#include <algorithm>
+
+convolver::convolver(size_t block_size, size_t channels, const float* response, size_t response_channels,
+                     size_t frames) : block_size_(block_size), channels_(channels),
+    response_channels_(response_channels), partitions_(std::max((frames + block_size - 1)/block_size, size_t(1))),
+    stride_((block_size + 4) & ~size_t(3)), head_(0), fft_(2*block_size),
+    response_re_(response_channels*partitions_*stride_), response_im_(response_re_.size()),
+    delay_re_(channels*partitions_*stride_), delay_im_(delay_re_.size()), history_(2*channels*block_size),
+    acc_re_(stride_), acc_im_(stride_), output_(2*block_size), work_(2*block_size) {
+    assert(channels > 0 && response_channels > 0 && "convolver requires channels");
+
+    // The inverse transform is unscaled, the partitions absorb its 1/(2*block_size)
+    const size_t B = block_size_;
+    const float scale = 1.f/(2*B);
+    for(size_t r = 0; r != response_channels_; ++r) {
+        for(size_t p = 0; p != partitions_; ++p) {
+            std::fill(output_.begin(), output_.end(), 0.f);
+            for(size_t i = 0; i != B && p*B + i < frames; ++i) {
+                output_[i] = scale * response[(p*B + i)*response_channels_ + r];
+            }
+            const size_t offset = (r*partitions_ + p)*stride_;
+            fft_.forward(output_.data(), response_re_.data() + offset, response_im_.data() + offset);
+        }
+    }
+
+    reset();
+}
+
+void convolver::reset() {
+    std::fill(delay_re_.begin(), delay_re_.end(), 0.f);
+    std::fill(delay_im_.begin(), delay_im_.end(), 0.f);
+    std::fill(history_.begin(), history_.end(), 0.f);
+    head_ = 0;
+}
+
+void convolver::process(const float* input, float* output) {
+    const size_t B = block_size_, P = partitions_, bins = fft_.bins();
+    for(size_t c = 0; c != channels_; ++c) {
+        float* history = history_.data() + 2*B*c;
+        std::copy(history + B, history + 2*B, history);
+        for(size_t i = 0; i != B; ++i) history[B + i] = input[i*channels_ + c];
+
+        float* delay_re = delay_re_.data() + c*P*stride_;
+        float* delay_im = delay_im_.data() + c*P*stride_;
+        fft_.forward(history, delay_re + head_*stride_, delay_im + head_*stride_);
+
+        // Partition p meets the spectrum of the block p blocks ago
+        const size_t r = c % response_channels_;
+        const float* response_re = response_re_.data() + r*P*stride_;
+        const float* response_im = response_im_.data() + r*P*stride_;
+        std::fill(acc_re_.begin(), acc_re_.end(), 0.f);
+        std::fill(acc_im_.begin(), acc_im_.end(), 0.f);
+        for(size_t p = 0, slot = head_; p != P; ++p, slot = slot == 0 ? P - 1 : slot - 1) {
+            complex_multiply_accumulate(delay_re + slot*stride_, delay_im + slot*stride_, response_re + p*stride_,
+                                        response_im + p*stride_, acc_re_.data(), acc_im_.data(), bins);
+        }
+
+        // The first half is wrapped by the circular convolution, the second half is the linear convolution
+        fft_.inverse(acc_re_.data(), acc_im_.data(), output_.data(), work_.data());
+        for(size_t i = 0; i != B; ++i) output[i*channels_ + c] = output_[B + i];
+    }
+
+    head_ = head_ + 1 == P ? 0 : head_ + 1;
+}
@@ -0,0 +1,55 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_CONVOLVER_HPP
+#define ZAPPLAYER_CONVOLVER_HPP
+
+/*
+ * Convolves interleaved blocks with a long impulse response by uniformly partitioned overlap-save.  The response is
+ * cut into partitions of block_size samples whose 2*block_size point spectra are computed once.  Every block the
+ * last two blocks of input are transformed with real_fft into the head of a frequency-domain delay line holding the
+ * spectra of the last partitions() blocks, the products of each delayed spectrum with its partition are summed and
+ * one inverse transform yields the block of output.  The output is not delayed and every block costs the same, two
+ * transforms per channel plus partitions() complex multiply-accumulates of block_size + 1 bins.
+ *
+ * A mono response is applied to every channel, otherwise channel c is convolved with response channel c modulo the
+ * response's channels.  Nothing is allocated after construction.
+ */
+
+#include <vector>
+#include <cstddef>
+#include "fft.hpp"
+
+class convolver {
+public:
+    // block_size must be a power of two, response holds frames interleaved frames of response_channels samples
+    convolver(size_t block_size, size_t channels, const float* response, size_t response_channels, size_t frames);
+
+    size_t block_size() const { return block_size_; }
+    size_t channels() const { return channels_; }
+    size_t partitions() const { return partitions_; }
+
+    // Convolves block_size() interleaved frames of input into output, which may alias input
+    void process(const float* input, float* output);
+
+    // Clears the input history
+    void reset();
+
+protected:
+    size_t block_size_;
+    size_t channels_;
+    size_t response_channels_;
+    size_t partitions_;
+    size_t stride_;                     // Bins padded to a multiple of four floats
+    size_t head_;                       // The delay line slot of the newest spectrum
+    real_fft fft_;
+    std::vector<float> response_re_;    // Per response channel, the spectra of the partitions in order
+    std::vector<float> response_im_;
+    std::vector<float> delay_re_;       // Per channel, the spectra of the last partitions() blocks of input
+    std::vector<float> delay_im_;
+    std::vector<float> history_;        // Per channel, the previous and the current block of input
+    std::vector<float> acc_re_;
+    std::vector<float> acc_im_;
+    std::vector<float> output_;
+    std::vector<float> work_;
+};
+
+#endif //ZAPPLAYER_CONVOLVER_HPP
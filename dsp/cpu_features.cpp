@@ -0,0 +1,61 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#include "cpu_features.hpp"
+
+#if defined(ZAPPLAYER_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+static cpu_features detect_features() {
+    cpu_features f = { false, false, false, false, false };
+#if defined(ZAPPLAYER_X86) && defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 0);
+    const int max_leaf = regs[0];
+    __cpuid(regs, 1);
+    f.sse2 = (regs[3] & (1 << 26)) != 0;
+    f.ssse3 = (regs[2] & (1 << 9)) != 0;
+    f.sse41 = (regs[2] & (1 << 19)) != 0;
+    const bool has_fma = (regs[2] & (1 << 12)) != 0;
+    const bool os_avx = (regs[2] & (1 << 27)) != 0 && (regs[2] & (1 << 28)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+    if(max_leaf >= 7 && os_avx) {
+        __cpuidex(regs, 7, 0);
+        f.avx2 = (regs[1] & (1 << 5)) != 0;
+        f.fma = has_fma;
+    }
+#elif defined(ZAPPLAYER_X86)
+    __builtin_cpu_init();
+    f.sse2 = __builtin_cpu_supports("sse2") != 0;
+    f.ssse3 = __builtin_cpu_supports("ssse3") != 0;
+    f.sse41 = __builtin_cpu_supports("sse4.1") != 0;
+    f.avx2 = __builtin_cpu_supports("avx2") != 0;
+    f.fma = __builtin_cpu_supports("fma") != 0;
+#endif
+    return f;
+}
+
+const cpu_features& get_cpu_features() {
+    static const cpu_features features = detect_features();
+    return features;
+}
+
+simd_level best_simd_level() {
+    const auto& f = get_cpu_features();
+    if(f.avx2 && f.fma) return simd_level::SL_AVX2;
+    if(f.sse2) return simd_level::SL_SSE2;
+    return simd_level::SL_SCALAR;
+}
+
+simd_level supported_simd_level(simd_level requested) {
+    const auto best = best_simd_level();
+    return int(requested) < int(best) ? requested : best;
+}
+
+const char* simd_level_name(simd_level level) {
+    switch(level) {
+        case simd_level::SL_SCALAR: return "scalar";
+        case simd_level::SL_SSE2: return "sse2";
+        case simd_level::SL_AVX2: return "avx2";
+    }
+    return "unknown";
+}
@@ -0,0 +1,43 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_CPU_FEATURES_HPP
+#define ZAPPLAYER_CPU_FEATURES_HPP
+
+/*
+ * Runtime CPU feature detection used to select SIMD kernels.  SSE2 is the x86 baseline, the wider kernels are only
+ * chosen when the CPU and the operating system both report support.
+ */
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ZAPPLAYER_X86
+#endif
+
+// SSE2 is available without runtime dispatch (always on x86-64 and on 32-bit builds targeting SSE2)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ZAPPLAYER_SSE2
+#endif
+
+enum class simd_level {
+    SL_SCALAR,
+    SL_SSE2,
+    SL_AVX2         // AVX2 + FMA
+};
+
+struct cpu_features {
+    bool sse2;
+    bool ssse3;
+    bool sse41;
+    bool avx2;
+    bool fma;
+};
+
+const cpu_features& get_cpu_features();
+
+// The widest level supported by the running CPU
+simd_level best_simd_level();
+
+// Clamps a requested level to what the running CPU supports
+simd_level supported_simd_level(simd_level requested);
+
+const char* simd_level_name(simd_level level);
+
+#endif //ZAPPLAYER_CPU_FEATURES_HPP
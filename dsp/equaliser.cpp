@@ -0,0 +1,201 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#include "equaliser.hpp"
+#include "cpu_features.hpp"
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+
+#if defined(ZAPPLAYER_SSE2)
+#include <emmintrin.h>
+#endif
+
+constexpr double eq_pi = 3.14159265358979323846;
+constexpr float eq_denormal_limit = 1e-15f;     // Far below one s16 step, flushed before it decays into denormals
+
+constexpr size_t equaliser::max_bands;
+
+equaliser::equaliser(float sample_rate, size_t channels, size_t bands) : sample_rate_(sample_rate),
+    channels_(channels), vectors_((std::min(std::max(bands, size_t(1)), max_bands) + 1)/2), ramp_(false) {
+    assert((channels == 1 || channels == 2) && "equaliser supports one or two channels");
+
+    const eq_band off = { eq_filter::EF_OFF, 1000.f, 0.f, .707f };
+    float coeffs[5];
+    design(off, coeffs);
+    for(size_t k = 0; k != 5; ++k) {
+        std::fill(coeffs_[k], coeffs_[k] + lanes, coeffs[k]);
+        std::fill(targets_[k], targets_[k] + lanes, coeffs[k]);
+    }
+    reset();
+}
+
+void equaliser::reset() {
+    std::fill(z1_, z1_ + lanes, 0.f);
+    std::fill(z2_, z2_ + lanes, 0.f);
+    std::fill(outputs_, outputs_ + lanes, 0.f);
+}
+
+void equaliser::set_bands(const eq_band* bands, size_t count) {
+    const eq_band off = { eq_filter::EF_OFF, 1000.f, 0.f, .707f };
+    for(size_t s = 0; s != stages(); ++s) {
+        float coeffs[5];
+        design(s < count ? bands[s] : off, coeffs);
+        const size_t lane = 4*(s/2) + 2*(s%2);
+        for(size_t k = 0; k != 5; ++k) {
+            targets_[k][lane] = targets_[k][lane + 1] = coeffs[k];
+            if(targets_[k][lane] != coeffs_[k][lane]) ramp_ = true;
+        }
+    }
+}
+
+void equaliser::design(const eq_band& band, float* coeffs) const {
+    if(band.filter == eq_filter::EF_OFF) {
+        coeffs[0] = 1.f;
+        coeffs[1] = coeffs[2] = coeffs[3] = coeffs[4] = 0.f;
+        return;
+    }
+
+    const double frequency = std::min(std::max(double(band.frequency), 1.), .49*sample_rate_);
+    const double w0 = 2.*eq_pi*frequency/sample_rate_;
+    const double cosw = std::cos(w0);
+    const double alpha = std::sin(w0)/(2.*std::max(double(band.q), .01));
+    const double A = std::pow(10., band.gain/40.);
+    const double sqrtA2alpha = 2.*std::sqrt(A)*alpha;
+
+    double b0, b1, b2, a0, a1, a2;
+    switch(band.filter) {
+        case eq_filter::EF_PEAK:
+            b0 = 1. + alpha*A; b1 = -2.*cosw; b2 = 1. - alpha*A;
+            a0 = 1. + alpha/A; a1 = -2.*cosw; a2 = 1. - alpha/A;
+            break;
+        case eq_filter::EF_LOW_SHELF:
+            b0 = A*((A + 1.) - (A - 1.)*cosw + sqrtA2alpha);
+            b1 = 2.*A*((A - 1.) - (A + 1.)*cosw);
+            b2 = A*((A + 1.) - (A - 1.)*cosw - sqrtA2alpha);
+            a0 = (A + 1.) + (A - 1.)*cosw + sqrtA2alpha;
+            a1 = -2.*((A - 1.) + (A + 1.)*cosw);
+            a2 = (A + 1.) + (A - 1.)*cosw - sqrtA2alpha;
+            break;
+        case eq_filter::EF_HIGH_SHELF:
+            b0 = A*((A + 1.) + (A - 1.)*cosw + sqrtA2alpha);
+            b1 = -2.*A*((A - 1.) + (A + 1.)*cosw);
+            b2 = A*((A + 1.) + (A - 1.)*cosw - sqrtA2alpha);
+            a0 = (A + 1.) - (A - 1.)*cosw + sqrtA2alpha;
+            a1 = 2.*((A - 1.) - (A + 1.)*cosw);
+            a2 = (A + 1.) - (A - 1.)*cosw - sqrtA2alpha;
+            break;
+        case eq_filter::EF_LOW_PASS:
+            b0 = .5*(1. - cosw); b1 = 1. - cosw; b2 = b0;
+            a0 = 1. + alpha; a1 = -2.*cosw; a2 = 1. - alpha;
+            break;
+        default:
+            b0 = .5*(1. + cosw); b1 = -(1. + cosw); b2 = b0;
+            a0 = 1. + alpha; a1 = -2.*cosw; a2 = 1. - alpha;
+            break;
+    }
+
+    coeffs[0] = float(b0/a0);
+    coeffs[1] = float(b1/a0);
+    coeffs[2] = float(b2/a0);
+    coeffs[3] = float(a1/a0);
+    coeffs[4] = float(a2/a0);
+}
+
+void equaliser::process(float* samples, size_t frames) {
+    if(frames == 0) return;
+
+    if(ramp_) {
+        process_frames<true>(samples, frames);
+        for(size_t k = 0; k != 5; ++k) std::copy(targets_[k], targets_[k] + lanes, coeffs_[k]);
+        ramp_ = false;
+    } else {
+        process_frames<false>(samples, frames);
+    }
+    flush_denormals();
+}
+
+template <bool Ramp>
+void equaliser::process_frames(float* samples, size_t frames) {
+    const size_t V = vectors_;
+    const float inv = 1.f/frames;
+#if defined(ZAPPLAYER_SSE2)
+    __m128 c[5][max_vectors], d[5][max_vectors], z1[max_vectors], z2[max_vectors], out[max_vectors];
+    for(size_t v = 0; v != V; ++v) {
+        for(size_t k = 0; k != 5; ++k) {
+            c[k][v] = _mm_loadu_ps(coeffs_[k] + 4*v);
+            if(Ramp) d[k][v] = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(targets_[k] + 4*v), c[k][v]), _mm_set1_ps(inv));
+        }
+        z1[v] = _mm_loadu_ps(z1_ + 4*v);
+        z2[v] = _mm_loadu_ps(z2_ + 4*v);
+        out[v] = _mm_loadu_ps(outputs_ + 4*v);
+    }
+
+    for(size_t t = 0; t != frames; ++t) {
+        // The new frame enters the upper lanes of the feed, where the first stage picks it up like any other output
+        const __m128 feed = channels_ == 2
+                          ? _mm_loadh_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(samples + 2*t))
+                          : _mm_set1_ps(samples[t]);
+        // In descending order so every stage reads its predecessor's output for the previous frame
+        for(size_t v = V; v-- != 0;) {
+            const __m128 in = _mm_shuffle_ps(v != 0 ? out[v-1] : feed, out[v], _MM_SHUFFLE(1, 0, 3, 2));
+            const __m128 y = _mm_add_ps(_mm_mul_ps(c[0][v], in), z1[v]);
+            z1[v] = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(c[1][v], in), _mm_mul_ps(c[3][v], y)), z2[v]);
+            z2[v] = _mm_sub_ps(_mm_mul_ps(c[2][v], in), _mm_mul_ps(c[4][v], y));
+            out[v] = y;
+            if(Ramp) {
+                for(size_t k = 0; k != 5; ++k) c[k][v] = _mm_add_ps(c[k][v], d[k][v]);
+            }
+        }
+
+        if(channels_ == 2) _mm_storeh_pi(reinterpret_cast<__m64*>(samples + 2*t), out[V-1]);
+        else               samples[t] = _mm_cvtss_f32(_mm_movehl_ps(out[V-1], out[V-1]));
+    }
+
+    for(size_t v = 0; v != V; ++v) {
+        _mm_storeu_ps(z1_ + 4*v, z1[v]);
+        _mm_storeu_ps(z2_ + 4*v, z2[v]);
+        _mm_storeu_ps(outputs_ + 4*v, out[v]);
+    }
+#else
+    const size_t L = 4*V;
+    float c[5][lanes], d[5][lanes], in[lanes];
+    for(size_t k = 0; k != 5; ++k) {
+        for(size_t l = 0; l != L; ++l) {
+            c[k][l] = coeffs_[k][l];
+            d[k][l] = (targets_[k][l] - coeffs_[k][l])*inv;
+        }
+    }
+
+    for(size_t t = 0; t != frames; ++t) {
+        // Stage s of channel c reads stage s - 1 of the previous frame, the first stage reads the new frame
+        for(size_t ch = 0; ch != 2; ++ch) {
+            in[ch] = samples[channels_ == 2 ? 2*t + ch : t];
+            for(size_t l = 2 + ch; l < L; l += 2) in[l] = outputs_[l - 2];
+        }
+
+        for(size_t l = 0; l != L; ++l) {
+            const float y = c[0][l]*in[l] + z1_[l];
+            z1_[l] = c[1][l]*in[l] - c[3][l]*y + z2_[l];
+            z2_[l] = c[2][l]*in[l] - c[4][l]*y;
+            outputs_[l] = y;
+            if(Ramp) {
+                for(size_t k = 0; k != 5; ++k) c[k][l] += d[k][l];
+            }
+        }
+
+        if(channels_ == 2) {
+            samples[2*t] = outputs_[L - 2];
+            samples[2*t + 1] = outputs_[L - 1];
+        } else {
+            samples[t] = outputs_[L - 2];
+        }
+    }
+#endif
+}
+
+void equaliser::flush_denormals() {
+    for(size_t l = 0; l != 4*vectors_; ++l) {
+        if(std::fabs(z1_[l]) < eq_denormal_limit) z1_[l] = 0.f;
+        if(std::fabs(z2_[l]) < eq_denormal_limit) z2_[l] = 0.f;
+        if(std::fabs(outputs_[l]) < eq_denormal_limit) outputs_[l] = 0.f;
+    }
+}
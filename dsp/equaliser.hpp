@@ -0,0 +1,77 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_EQUALISER_HPP
+#define ZAPPLAYER_EQUALISER_HPP
+
+/*
+ * A parametric equaliser of up to max_bands cascaded biquads (RBJ cookbook designs in transposed direct form II) on
+ * interleaved float blocks of one or two channels.
+ *
+ * The cascade is pipelined so that both channels of two consecutive biquads share one SSE register: every biquad
+ * processes its input one frame after the biquad before it, so the registers of one frame are independent of each
+ * other and only depend on the previous frame.  The cost is a delay of stages() - 1 frames (0.2 ms for ten bands at
+ * 44.1 kHz), fixed at construction so that changing the bands never moves the audio.
+ *
+ * set_bands() designs the new coefficients and the next process() interpolates every coefficient linearly from the
+ * old to the new values over its block, the stability region of a biquad's denominator is convex so every
+ * intermediate filter is stable.  Nothing is allocated after construction.
+ */
+
+#include <cstddef>
+
+enum class eq_filter {
+    EF_OFF,                 // Passes the signal unchanged
+    EF_PEAK,
+    EF_LOW_SHELF,
+    EF_HIGH_SHELF,
+    EF_LOW_PASS,
+    EF_HIGH_PASS
+};
+
+struct eq_band {
+    eq_filter filter;
+    float frequency;        // Centre, corner or shelf midpoint in Hz
+    float gain;             // dB, peak and shelves only
+    float q;                // Bandwidth of the peak, resonance of the passes and slope of the shelves (.707 is flat)
+};
+
+class equaliser {
+public:
+    constexpr static size_t max_bands = 10;
+
+    // bands is rounded up to an even number of stages
+    equaliser(float sample_rate, size_t channels, size_t bands=max_bands);
+
+    float sample_rate() const { return sample_rate_; }
+    size_t channels() const { return channels_; }
+    size_t stages() const { return 2*vectors_; }
+    size_t latency() const { return stages() - 1; }
+
+    // Replaces the bands, those beyond count are turned off.  Takes effect over the next process() call.
+    void set_bands(const eq_band* bands, size_t count);
+
+    // Filters frames interleaved sample frames in place, the output lags the input by latency() frames
+    void process(float* samples, size_t frames);
+
+    // Clears the filter state, the coefficients are kept
+    void reset();
+
+protected:
+    template <bool Ramp> void process_frames(float* samples, size_t frames);
+    void design(const eq_band& band, float* coeffs) const;
+    void flush_denormals();
+
+    constexpr static size_t max_vectors = max_bands/2;
+    constexpr static size_t lanes = 4*max_vectors;     // Lane 4v + 2s + c is stage 2v + s of channel c
+
+    float sample_rate_;
+    size_t channels_;
+    size_t vectors_;
+    bool ramp_;                         // The targets differ from the coefficients
+    float coeffs_[5][lanes];            // b0, b1, b2, a1, a2 of every lane
+    float targets_[5][lanes];
+    float z1_[lanes];
+    float z2_[lanes];
+    float outputs_[lanes];              // The output of every stage for the previous frame
+};
+
+#endif //ZAPPLAYER_EQUALISER_HPP
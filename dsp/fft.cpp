@@ -0,0 +1,154 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#include "fft.hpp"
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+
+constexpr double fft_two_pi = 6.28318530717958647692;
+
+inline bool is_pow2(size_t n) { return n != 0 && (n & (n - 1)) == 0; }
+
+static fft_kernel_fnc select_kernel(simd_level level, size_t size) {
+#if defined(ZAPPLAYER_X86)
+    // The SIMD kernels work on whole vectors of four (SSE2) or eight (AVX2) groups
+    if(level == simd_level::SL_AVX2 && size >= 32) return &fft_butterflies_avx2;
+    if(level >= simd_level::SL_SSE2 && size >= 16) return &fft_butterflies_sse2;
+#endif
+    return &fft_butterflies_scalar;
+}
+
+fft_plan::fft_plan(size_t size, simd_level level) : size_(size), level_(supported_simd_level(level)),
+    kernel_(select_kernel(level_, size)), twiddle_re_(size > 1 ? size - 1 : 1), twiddle_im_(twiddle_re_.size()) {
+    assert(is_pow2(size) && "fft_plan requires a power of two size");
+
+    size_t bits = 0;
+    while((size_t(1) << bits) < size_) ++bits;
+
+    for(size_t i = 0; i != size_; ++i) {
+        size_t j = 0;
+        for(size_t b = 0; b != bits; ++b) j |= ((i >> b) & 1) << (bits - 1 - b);
+        if(i < j) {
+            swaps_.push_back(uint32_t(i));
+            swaps_.push_back(uint32_t(j));
+        }
+    }
+
+    for(size_t m = 1; m < size_; m <<= 1) {
+        for(size_t j = 0; j != m; ++j) {
+            const double arg = fft_two_pi * j / (2*m);
+            twiddle_re_[m - 1 + j] = float(std::cos(arg));
+            twiddle_im_[m - 1 + j] = float(-std::sin(arg));
+        }
+    }
+}
+
+void fft_plan::forward(float* re, float* im) const {
+    for(size_t s = 0; s < swaps_.size(); s += 2) {
+        const auto i = swaps_[s], j = swaps_[s+1];
+        std::swap(re[i], re[j]);
+        std::swap(im[i], im[j]);
+    }
+
+    kernel_(re, im, size_, twiddle_re_.data(), twiddle_im_.data());
+}
+
+void fft_butterflies_scalar(float* re, float* im, size_t n, const float* tw_re, const float* tw_im) {
+    for(size_t m = 1; m < n; m <<= 1) {
+        const float* wr = tw_re + m - 1;
+        const float* wi = tw_im + m - 1;
+        for(size_t k = 0; k < n; k += 2*m) {
+            float* ar = re + k; float* ai = im + k;
+            float* br = ar + m; float* bi = ai + m;
+            for(size_t j = 0; j != m; ++j) {
+                const float tr = br[j] * wr[j] - bi[j] * wi[j];
+                const float ti = br[j] * wi[j] + bi[j] * wr[j];
+                br[j] = ar[j] - tr; bi[j] = ai[j] - ti;
+                ar[j] += tr;        ai[j] += ti;
+            }
+        }
+    }
+}
+
+real_fft::real_fft(size_t size, simd_level level) : size_(size), plan_(size/2, level), twiddle_re_(size/4 + 1),
+    twiddle_im_(size/4 + 1) {
+    assert(size >= 4 && "real_fft requires at least four samples");
+    for(size_t k = 0; k <= size_/4; ++k) {
+        const double arg = fft_two_pi * k / size_;
+        twiddle_re_[k] = float(std::cos(arg));
+        twiddle_im_[k] = float(-std::sin(arg));
+    }
+}
+
+void real_fft::forward(const float* input, float* re, float* im) const {
+    // Even samples become the real part and odd samples the imaginary part of an N/2 point complex signal
+    const size_t M = size_/2;
+    for(size_t i = 0; i != M; ++i) {
+        re[i] = input[2*i];
+        im[i] = input[2*i+1];
+    }
+
+    plan_.forward(re, im);
+
+    const float z0r = re[0], z0i = im[0];
+    re[0] = z0r + z0i; im[0] = 0.f;
+    re[M] = z0r - z0i; im[M] = 0.f;
+
+    // X[k] = E[k] + W^k O[k] and X[M-k] = conj(E[k] - W^k O[k]) where E and O are the even and odd spectra
+    for(size_t k = 1; k <= M/2; ++k) {
+        const size_t c = M - k;
+        const float er = .5f*(re[k] + re[c]), ei = .5f*(im[k] - im[c]);
+        const float orr = .5f*(im[k] + im[c]), oi = -.5f*(re[k] - re[c]);
+        const float wr = twiddle_re_[k], wi = twiddle_im_[k];
+        const float tr = orr * wr - oi * wi, ti = orr * wi + oi * wr;
+        re[k] = er + tr; im[k] = ei + ti;
+        re[c] = er - tr; im[c] = ti - ei;
+    }
+}
+
+void real_fft::inverse(const float* re, const float* im, float* output, float* work) const {
+    // Rebuild the packed N/2 point spectrum Z[k] = E[k] + iO[k] from X[k] and conj(X[M-k]), doubled for the scaling
+    const size_t M = size_/2;
+    float* zr = work;
+    float* zi = work + M;
+
+    zr[0] = re[0] + re[M];
+    zi[0] = re[0] - re[M];
+
+    for(size_t k = 1; k <= M/2; ++k) {
+        const size_t c = M - k;
+        const float er = re[k] + re[c], ei = im[k] - im[c];
+        const float dr = re[k] - re[c], di = im[k] + im[c];
+        // O = (X[k] - conj(X[M-k])) conj(W^k)
+        const float wr = twiddle_re_[k], wi = -twiddle_im_[k];
+        const float orr = dr * wr - di * wi, oi = dr * wi + di * wr;
+        zr[k] = er - oi; zi[k] = ei + orr;
+        zr[c] = er + oi; zi[c] = orr - ei;
+    }
+
+    plan_.inverse(zr, zi);
+
+    for(size_t i = 0; i != M; ++i) {
+        output[2*i] = zr[i];
+        output[2*i+1] = zi[i];
+    }
+}
+
+stereo_fft::stereo_fft(size_t size, simd_level level) : plan_(size, level) {
+    assert(size >= 2 && "stereo_fft requires at least two samples");
+}
+
+void stereo_fft::forward(float* left, float* right, float* left_re, float* left_im, float* right_re,
+                         float* right_im) const {
+    plan_.forward(left, right);
+
+    const size_t N = plan_.size();
+    const float* zr = left;
+    const float* zi = right;
+    for(size_t k = 0; k <= N/2; ++k) {
+        const size_t c = (N - k) & (N - 1);
+        left_re[k] = .5f*(zr[k] + zr[c]);
+        left_im[k] = .5f*(zi[k] - zi[c]);
+        right_re[k] = .5f*(zi[k] + zi[c]);
+        right_im[k] = .5f*(zr[c] - zr[k]);
+    }
+}
@@ -0,0 +1,82 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_FFT_HPP
+#define ZAPPLAYER_FFT_HPP
+
+/*
+ * Precomputed FFT plans.  A plan holds the bit-reversal permutation and the twiddle factors for one transform size so
+ * that the per-frame cost is only the butterflies.  Plans are immutable once built and may be shared between threads.
+ *
+ * fft_plan is an in-place complex transform on split data (separate real and imaginary arrays).  The butterflies are
+ * selected at construction from the scalar, SSE2 or AVX2/FMA kernels according to what the CPU reports.
+ *
+ * real_fft transforms N real samples by packing them into an N/2 point complex transform and then separating the
+ * even and odd spectra into the N/2+1 non-redundant bins.
+ *
+ * stereo_fft transforms two real signals of N samples with one N point complex transform of z = x + iy, separating
+ * X[k] = (Z[k] + conj(Z[N-k]))/2 and Y[k] = (Z[k] - conj(Z[N-k]))/2i afterwards.
+ */
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "cpu_features.hpp"
+#include "fft_kernels.hpp"
+
+class fft_plan {
+public:
+    explicit fft_plan(size_t size, simd_level level=best_simd_level());
+
+    size_t size() const { return size_; }
+    simd_level level() const { return level_; }
+
+    void forward(float* re, float* im) const;
+    void inverse(float* re, float* im) const { forward(im, re); }   // Unscaled, divide by size() to invert forward
+
+protected:
+    size_t size_;
+    simd_level level_;
+    fft_kernel_fnc kernel_;
+    std::vector<uint32_t> swaps_;       // Pairs of indices (i, j) with i < j exchanged by the bit-reversal
+    std::vector<float> twiddle_re_;     // exp(-2*pi*i*j/2m) for j in [0, m), stage m stored at offset m-1
+    std::vector<float> twiddle_im_;
+};
+
+class real_fft {
+public:
+    explicit real_fft(size_t size, simd_level level=best_simd_level());
+
+    size_t size() const { return size_; }
+    size_t bins() const { return size_/2 + 1; }
+
+    // Transforms size() real samples into bins() complex values.  re and im must each hold bins() floats.
+    void forward(const float* input, float* re, float* im) const;
+
+    // Transforms bins() complex values of a Hermitian spectrum back into size() real samples, unscaled so that
+    // inverse(forward(x)) = size()*x.  work must hold size() floats, output may not alias the inputs.
+    void inverse(const float* re, const float* im, float* output, float* work) const;
+
+    const fft_plan& plan() const { return plan_; }
+
+protected:
+    size_t size_;
+    fft_plan plan_;
+    std::vector<float> twiddle_re_;     // exp(-2*pi*i*k/N) for k in [0, N/4]
+    std::vector<float> twiddle_im_;
+};
+
+class stereo_fft {
+public:
+    explicit stereo_fft(size_t size, simd_level level=best_simd_level());
+
+    size_t size() const { return plan_.size(); }
+    size_t bins() const { return plan_.size()/2 + 1; }
+
+    // Transforms size() samples of left and right, which are overwritten, into bins() complex values each.  The
+    // outputs may not alias the inputs.
+    void forward(float* left, float* right, float* left_re, float* left_im, float* right_re, float* right_im) const;
+
+protected:
+    fft_plan plan_;
+};
+
+#endif //ZAPPLAYER_FFT_HPP
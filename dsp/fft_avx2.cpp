@@ -0,0 +1,37 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#include "cpu_features.hpp"
+#include "fft_kernels.hpp"
+
+/*
+ * This file is built with AVX2/FMA code generation and must only be entered after get_cpu_features() reports both.
+ */
+
+#if defined(ZAPPLAYER_X86)
+#include <immintrin.h>
+
+void fft_butterflies_avx2(float* re, float* im, size_t n, const float* tw_re, const float* tw_im) {
+    // The SSE2 passes run first so that no AVX state is live when they execute
+    fft_radix4_pass_sse2(re, im, n);
+    fft_radix2_stage_sse2(re, im, n, 4, tw_re + 3, tw_im + 3);
+
+    for(size_t m = 8; m < n; m <<= 1) {
+        const float* wr = tw_re + m - 1;
+        const float* wi = tw_im + m - 1;
+        for(size_t k = 0; k < n; k += 2*m) {
+            float* ar = re + k; float* ai = im + k;
+            float* br = ar + m; float* bi = ai + m;
+            for(size_t j = 0; j < m; j += 8) {
+                const __m256 w_r = _mm256_loadu_ps(wr + j), w_i = _mm256_loadu_ps(wi + j);
+                const __m256 x_r = _mm256_loadu_ps(br + j), x_i = _mm256_loadu_ps(bi + j);
+                const __m256 tr = _mm256_fmsub_ps(x_r, w_r, _mm256_mul_ps(x_i, w_i));
+                const __m256 ti = _mm256_fmadd_ps(x_r, w_i, _mm256_mul_ps(x_i, w_r));
+                const __m256 u_r = _mm256_loadu_ps(ar + j), u_i = _mm256_loadu_ps(ai + j);
+                _mm256_storeu_ps(ar + j, _mm256_add_ps(u_r, tr)); _mm256_storeu_ps(ai + j, _mm256_add_ps(u_i, ti));
+                _mm256_storeu_ps(br + j, _mm256_sub_ps(u_r, tr)); _mm256_storeu_ps(bi + j, _mm256_sub_ps(u_i, ti));
+            }
+        }
+    }
+    _mm256_zeroupper();
+}
+
+#endif //ZAPPLAYER_X86
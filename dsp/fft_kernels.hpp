@@ -0,0 +1,62 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_FFT_KERNELS_HPP
+#define ZAPPLAYER_FFT_KERNELS_HPP
+
+/*
+ * Internal butterfly kernels for fft_plan.  Each kernel receives bit-reversed split (SoA) data and the per-stage
+ * twiddle table, where the twiddles for the stage with half-length m are stored contiguously at offset m-1.  The
+ * SIMD kernels fuse the first two stages into a single radix-4 pass and then run unit-stride radix-2 stages.
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+using fft_kernel_fnc = void (*)(float* re, float* im, size_t n, const float* tw_re, const float* tw_im);
+
+void fft_butterflies_scalar(float* re, float* im, size_t n, const float* tw_re, const float* tw_im);
+
+#if defined(ZAPPLAYER_X86)
+void fft_butterflies_sse2(float* re, float* im, size_t n, const float* tw_re, const float* tw_im);
+void fft_butterflies_avx2(float* re, float* im, size_t n, const float* tw_re, const float* tw_im);
+
+// Shared passes used by the AVX2 kernel for the short stages
+void fft_radix4_pass_sse2(float* re, float* im, size_t n);
+void fft_radix2_stage_sse2(float* re, float* im, size_t n, size_t m, const float* wr, const float* wi);
+#endif
+
+/*
+ * Internal Q15 kernels for q15_real_fft.  The window kernels scale s16 samples by 2^left_shift, multiply them by the
+ * Q15 window and divide them by 2^right_shift, writing the even samples to even and the odd samples to odd.  The
+ * butterflies receive bit-reversed data no larger than q15_input_limit in magnitude, halve the frame before any stage
+ * whose input could overflow, write the final peak magnitude to peak and return the number of halvings.
+ */
+
+constexpr int q15_input_limit = 2047;       // Three stages may grow values by eight without saturating
+constexpr int q15_stage_limit = 8191;       // A radix-2 butterfly may grow values by 1 + sqrt(2)
+
+using q15_window_fnc = void (*)(const short* input, const int16_t* window, int16_t* even, int16_t* odd, size_t len,
+                                int left_shift, int right_shift);
+using q15_kernel_fnc = int (*)(int16_t* re, int16_t* im, size_t n, const int16_t* tw_re, const int16_t* tw_im,
+                               int* peak);
+
+void q15_window_scalar(const short* input, const int16_t* window, int16_t* even, int16_t* odd, size_t len,
+                       int left_shift, int right_shift);
+int q15_butterflies_scalar(int16_t* re, int16_t* im, size_t n, const int16_t* tw_re, const int16_t* tw_im,
+                           int* peak);
+
+#if defined(ZAPPLAYER_X86)
+// Requires SSSE3 and n >= 64
+void q15_window_ssse3(const short* input, const int16_t* window, int16_t* even, int16_t* odd, size_t len,
+                      int left_shift, int right_shift);
+int q15_butterflies_ssse3(int16_t* re, int16_t* im, size_t n, const int16_t* tw_re, const int16_t* tw_im,
+                          int* peak);
+#endif
+
+// The number of halvings that bring peak to at most limit
+inline int q15_headroom_shift(int peak, int limit) {
+    int shift = 0;
+    while((peak >> shift) >= limit) ++shift;
+    return shift;
+}
+
+#endif //ZAPPLAYER_FFT_KERNELS_HPP
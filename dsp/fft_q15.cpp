@@ -0,0 +1,220 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#include "fft_q15.hpp"
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+
+#if defined(ZAPPLAYER_SSE2)
+#include <emmintrin.h>
+#endif
+
+constexpr double q15_two_pi = 6.28318530717958647692;
+
+// The scalar equivalents of paddsw and pmulhrsw
+inline int16_t q15_sat(int32_t value) {
+    return int16_t(std::min(std::max(value, int32_t(-32768)), int32_t(32767)));
+}
+
+inline int16_t q15_mul(int16_t a, int16_t b) {
+    return q15_sat((int32_t(a)*b + 0x4000) >> 15);
+}
+
+inline int16_t q15_round_shift(int16_t value, int shift) {
+    return shift == 0 ? value : int16_t((int32_t(value) + (1 << (shift - 1))) >> shift);
+}
+
+static int16_t to_q15(double value) {
+    return int16_t(std::lround(std::min(std::max(value, -1.), 1.)*32767.));
+}
+
+static int peak_magnitude(const short* input, size_t len) {
+    int hi = 0, lo = 0;
+    size_t i = 0;
+#if defined(ZAPPLAYER_SSE2)
+    __m128i vhi = _mm_setzero_si128(), vlo = _mm_setzero_si128();
+    for(; i + 8 <= len; i += 8) {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+        vhi = _mm_max_epi16(vhi, x);
+        vlo = _mm_min_epi16(vlo, x);
+    }
+    vhi = _mm_max_epi16(vhi, _mm_srli_si128(vhi, 8)); vlo = _mm_min_epi16(vlo, _mm_srli_si128(vlo, 8));
+    vhi = _mm_max_epi16(vhi, _mm_srli_si128(vhi, 4)); vlo = _mm_min_epi16(vlo, _mm_srli_si128(vlo, 4));
+    vhi = _mm_max_epi16(vhi, _mm_srli_si128(vhi, 2)); vlo = _mm_min_epi16(vlo, _mm_srli_si128(vlo, 2));
+    hi = int16_t(_mm_cvtsi128_si32(vhi));
+    lo = int16_t(_mm_cvtsi128_si32(vlo));
+#endif
+    for(; i != len; ++i) {
+        hi = std::max(hi, int(input[i]));
+        lo = std::min(lo, int(input[i]));
+    }
+    return std::max(hi, -lo);
+}
+
+static q15_window_fnc select_window(simd_level level, size_t size) {
+#if defined(ZAPPLAYER_X86)
+    if(level >= simd_level::SL_SSE2 && get_cpu_features().ssse3 && size >= 128) return &q15_window_ssse3;
+#endif
+    return &q15_window_scalar;
+}
+
+static q15_kernel_fnc select_butterflies(simd_level level, size_t size) {
+#if defined(ZAPPLAYER_X86)
+    if(level >= simd_level::SL_SSE2 && get_cpu_features().ssse3 && size >= 128) return &q15_butterflies_ssse3;
+#endif
+    return &q15_butterflies_scalar;
+}
+
+q15_real_fft::q15_real_fft(size_t size, simd_level level) : size_(size),
+    window_(select_window(supported_simd_level(level), size)),
+    butterflies_(select_butterflies(supported_simd_level(level), size)), twiddle_re_(size/2 - 1),
+    twiddle_im_(twiddle_re_.size()), split_re_(size/4 + 1), split_im_(size/4 + 1) {
+    assert(size >= 8 && (size & (size - 1)) == 0 && "q15_real_fft requires a power of two of at least eight");
+
+    const size_t M = size_/2;
+    size_t bits = 0;
+    while((size_t(1) << bits) < M) ++bits;
+
+    for(size_t i = 0; i != M; ++i) {
+        size_t j = 0;
+        for(size_t b = 0; b != bits; ++b) j |= ((i >> b) & 1) << (bits - 1 - b);
+        if(i < j) {
+            swaps_.push_back(uint32_t(i));
+            swaps_.push_back(uint32_t(j));
+        }
+    }
+
+    for(size_t m = 1; m < M; m <<= 1) {
+        for(size_t j = 0; j != m; ++j) {
+            const double arg = q15_two_pi * j / (2*m);
+            twiddle_re_[m - 1 + j] = to_q15(std::cos(arg));
+            twiddle_im_[m - 1 + j] = to_q15(-std::sin(arg));
+        }
+    }
+
+    for(size_t k = 0; k <= size_/4; ++k) {
+        const double arg = q15_two_pi * k / size_;
+        split_re_[k] = to_q15(std::cos(arg));
+        split_im_[k] = to_q15(-std::sin(arg));
+    }
+}
+
+int q15_real_fft::forward(const short* input, const int16_t* window, int16_t* re, int16_t* im) const {
+    // Normalise the frame so that its peak lies in (q15_input_limit/2, q15_input_limit]
+    const int peak = peak_magnitude(input, size_);
+    if(peak == 0) {
+        std::fill(re, re + bins(), int16_t(0));
+        std::fill(im, im + bins(), int16_t(0));
+        return 0;
+    }
+
+    int left_shift = 0;
+    while((peak << (left_shift + 1)) <= q15_input_limit) ++left_shift;
+    const int right_shift = q15_headroom_shift(peak, q15_input_limit);
+
+    // Even samples become the real part and odd samples the imaginary part of an N/2 point complex signal
+    const size_t M = size_/2;
+    window_(input, window, re, im, size_, left_shift, right_shift);
+    for(size_t s = 0; s < swaps_.size(); s += 2) {
+        const auto i = swaps_[s], j = swaps_[s+1];
+        std::swap(re[i], re[j]);
+        std::swap(im[i], im[j]);
+    }
+
+    int stage_peak = 0;
+    const int halvings = butterflies_(re, im, M, twiddle_re_.data(), twiddle_im_.data(), &stage_peak);
+
+    // The split computes twice E[k] and W^k O[k] exactly in 32 bits and halves the sum once, the values entering it
+    // are limited as for a butterfly
+    const int shift = q15_headroom_shift(stage_peak, q15_stage_limit);
+    const int32_t z0r = q15_round_shift(re[0], shift), z0i = q15_round_shift(im[0], shift);
+    re[0] = int16_t(z0r + z0i); im[0] = 0;
+    re[M] = int16_t(z0r - z0i); im[M] = 0;
+
+    for(size_t k = 1; k <= M/2; ++k) {
+        const size_t c = M - k;
+        const int32_t kr = q15_round_shift(re[k], shift), ki = q15_round_shift(im[k], shift);
+        const int32_t cr = q15_round_shift(re[c], shift), ci = q15_round_shift(im[c], shift);
+        const int32_t er = kr + cr, ei = ki - ci;
+        const int32_t orr = ki + ci, oi = cr - kr;
+        const int32_t wr = split_re_[k], wi = split_im_[k];
+        const int32_t tr = (orr * wr - oi * wi + 0x4000) >> 15, ti = (orr * wi + oi * wr + 0x4000) >> 15;
+        re[k] = int16_t((er + tr + 1) >> 1); im[k] = int16_t((ei + ti + 1) >> 1);
+        re[c] = int16_t((er - tr + 1) >> 1); im[c] = int16_t((ti - ei + 1) >> 1);
+    }
+
+    return right_shift - left_shift + halvings + shift;
+}
+
+void q15_window_scalar(const short* input, const int16_t* window, int16_t* even, int16_t* odd, size_t len,
+                       int left_shift, int right_shift) {
+    for(size_t i = 0; i != len; ++i) {
+        const int16_t x = int16_t(input[i] * (1 << left_shift));
+        const int16_t y = q15_round_shift(q15_mul(x, window[i]), right_shift);
+        if(i & 1) odd[i >> 1] = y;
+        else      even[i >> 1] = y;
+    }
+}
+
+int q15_butterflies_scalar(int16_t* re, int16_t* im, size_t n, const int16_t* tw_re, const int16_t* tw_im,
+                           int* peak) {
+    int halvings = 0, shift = 0;
+    for(size_t m = 1; m < n; m <<= 1) {
+        const int16_t* wr = tw_re + m - 1;
+        const int16_t* wi = tw_im + m - 1;
+        int hi = 0, lo = 0;
+        for(size_t k = 0; k < n; k += 2*m) {
+            int16_t* ar = re + k; int16_t* ai = im + k;
+            int16_t* br = ar + m; int16_t* bi = ai + m;
+            for(size_t j = 0; j != m; ++j) {
+                const int16_t ur = q15_round_shift(ar[j], shift), ui = q15_round_shift(ai[j], shift);
+                const int16_t xr = q15_round_shift(br[j], shift), xi = q15_round_shift(bi[j], shift);
+                const int16_t tr = q15_sat(int32_t(q15_mul(xr, wr[j])) - q15_mul(xi, wi[j]));
+                const int16_t ti = q15_sat(int32_t(q15_mul(xr, wi[j])) + q15_mul(xi, wr[j]));
+                ar[j] = q15_sat(int32_t(ur) + tr); ai[j] = q15_sat(int32_t(ui) + ti);
+                br[j] = q15_sat(int32_t(ur) - tr); bi[j] = q15_sat(int32_t(ui) - ti);
+                hi = std::max({hi, int(ar[j]), int(ai[j]), int(br[j]), int(bi[j])});
+                lo = std::min({lo, int(ar[j]), int(ai[j]), int(br[j]), int(bi[j])});
+            }
+        }
+        halvings += shift;
+        *peak = std::max(hi, -lo);
+        shift = q15_headroom_shift(*peak, q15_stage_limit);
+    }
+    return halvings;
+}
+
+void float_to_q15(const float* input, int16_t* output, size_t len) {
+    for(size_t i = 0; i != len; ++i) output[i] = to_q15(input[i]);
+}
+
+void q15_power_spectrum(const int16_t* re, const int16_t* im, float* power, size_t len, float scale) {
+    size_t i = 0;
+#if defined(ZAPPLAYER_SSE2)
+    // pmaddwd on interleaved (re, im) pairs gives re^2 + im^2 in 32 bits, exact unless both are -32768
+    const __m128 s = _mm_set1_ps(scale);
+    for(; i + 8 <= len; i += 8) {
+        const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(re + i));
+        const __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(im + i));
+        const __m128i lo = _mm_unpacklo_epi16(r, m), hi = _mm_unpackhi_epi16(r, m);
+        _mm_storeu_ps(power + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_madd_epi16(lo, lo)), s));
+        _mm_storeu_ps(power + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_madd_epi16(hi, hi)), s));
+    }
+#endif
+    for(; i != len; ++i) power[i] = scale * float(int32_t(re[i])*re[i] + int32_t(im[i])*im[i]);
+}
+
+void q15_to_float(const int16_t* input, float* output, size_t len, float scale) {
+    size_t i = 0;
+#if defined(ZAPPLAYER_SSE2)
+    const __m128 s = _mm_set1_ps(scale);
+    for(; i + 8 <= len; i += 8) {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+        // Sign extend by placing each value in the high half of a 32 bit lane
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+        _mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), s));
+        _mm_storeu_ps(output + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), s));
+    }
+#endif
+    for(; i != len; ++i) output[i] = scale * input[i];
+}
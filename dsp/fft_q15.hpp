@@ -0,0 +1,54 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_FFT_Q15_HPP
+#define ZAPPLAYER_FFT_Q15_HPP
+
+/*
+ * A fixed-point real FFT on s16 samples for CPUs with poor float throughput.  Values are Q15 (int16_t scaled by 2^15)
+ * with block floating-point scaling: one exponent is shared by the whole frame.  The input is normalised so that the
+ * first three stages cannot overflow, and before every later stage the frame is halved once or twice if its peak
+ * could overflow the butterflies.  Arithmetic saturates rather than wraps.  The result has roughly 12 to 14
+ * significant bits, enough for the analyser's dB range but not for the pitch models.
+ *
+ * The butterflies use pmulhrsw (SSSE3) for the rounded Q15 products when the CPU has it and plain integer code
+ * otherwise, selected at construction like fft_plan.
+ */
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "cpu_features.hpp"
+#include "fft_kernels.hpp"
+
+class q15_real_fft {
+public:
+    explicit q15_real_fft(size_t size, simd_level level=best_simd_level());
+
+    size_t size() const { return size_; }
+    size_t bins() const { return size_/2 + 1; }
+    bool simd() const { return butterflies_ != &q15_butterflies_scalar; }
+
+    // Windows size() samples with a Q15 window and transforms them into bins() complex values of re and im, which
+    // must each hold bins() values.  Returns the exponent e for which the spectrum of input is (re + i*im)*2^e.
+    int forward(const short* input, const int16_t* window, int16_t* re, int16_t* im) const;
+
+protected:
+    size_t size_;
+    q15_window_fnc window_;
+    q15_kernel_fnc butterflies_;
+    std::vector<uint32_t> swaps_;       // Bit-reversal pairs of the size/2 point complex transform
+    std::vector<int16_t> twiddle_re_;   // Per-stage twiddles as in fft_plan
+    std::vector<int16_t> twiddle_im_;
+    std::vector<int16_t> split_re_;     // exp(-2*pi*i*k/N) for k in [0, N/4]
+    std::vector<int16_t> split_im_;
+};
+
+// output[i] = round(input[i]*32767), input is expected in [-1, 1]
+void float_to_q15(const float* input, int16_t* output, size_t len);
+
+// power[i] = scale * (re[i]^2 + im[i]^2)
+void q15_power_spectrum(const int16_t* re, const int16_t* im, float* power, size_t len, float scale);
+
+// output[i] = scale * input[i]
+void q15_to_float(const int16_t* input, float* output, size_t len, float scale);
+
+#endif //ZAPPLAYER_FFT_Q15_HPP
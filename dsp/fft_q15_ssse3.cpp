@@ -0,0 +1,169 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#include "cpu_features.hpp"
+#include "fft_kernels.hpp"
+
+#if defined(ZAPPLAYER_X86)
+#include <tmmintrin.h>
+
+// cos(pi/4) in Q15
+constexpr static short q15_sqrt_half = 23170;
+
+// pmulhrsw by 2^(15 - shift) is a rounded arithmetic shift right, by 32767 it leaves values below 16384 unchanged
+static __m128i shift_multiplier(int shift) {
+    return _mm_set1_epi16(short(shift == 0 ? 32767 : 1 << (15 - shift)));
+}
+
+static void transpose8_epi16(__m128i* r) {
+    const __m128i a0 = _mm_unpacklo_epi16(r[0], r[1]), a1 = _mm_unpackhi_epi16(r[0], r[1]);
+    const __m128i a2 = _mm_unpacklo_epi16(r[2], r[3]), a3 = _mm_unpackhi_epi16(r[2], r[3]);
+    const __m128i a4 = _mm_unpacklo_epi16(r[4], r[5]), a5 = _mm_unpackhi_epi16(r[4], r[5]);
+    const __m128i a6 = _mm_unpacklo_epi16(r[6], r[7]), a7 = _mm_unpackhi_epi16(r[6], r[7]);
+    const __m128i b0 = _mm_unpacklo_epi32(a0, a2), b1 = _mm_unpackhi_epi32(a0, a2);
+    const __m128i b2 = _mm_unpacklo_epi32(a1, a3), b3 = _mm_unpackhi_epi32(a1, a3);
+    const __m128i b4 = _mm_unpacklo_epi32(a4, a6), b5 = _mm_unpackhi_epi32(a4, a6);
+    const __m128i b6 = _mm_unpacklo_epi32(a5, a7), b7 = _mm_unpackhi_epi32(a5, a7);
+    r[0] = _mm_unpacklo_epi64(b0, b4); r[1] = _mm_unpackhi_epi64(b0, b4);
+    r[2] = _mm_unpacklo_epi64(b1, b5); r[3] = _mm_unpackhi_epi64(b1, b5);
+    r[4] = _mm_unpacklo_epi64(b2, b6); r[5] = _mm_unpackhi_epi64(b2, b6);
+    r[6] = _mm_unpacklo_epi64(b3, b7); r[7] = _mm_unpackhi_epi64(b3, b7);
+}
+
+static int peak_of(__m128i hi, __m128i lo) {
+    hi = _mm_max_epi16(hi, _mm_srli_si128(hi, 8)); lo = _mm_min_epi16(lo, _mm_srli_si128(lo, 8));
+    hi = _mm_max_epi16(hi, _mm_srli_si128(hi, 4)); lo = _mm_min_epi16(lo, _mm_srli_si128(lo, 4));
+    hi = _mm_max_epi16(hi, _mm_srli_si128(hi, 2)); lo = _mm_min_epi16(lo, _mm_srli_si128(lo, 2));
+    const int max = short(_mm_cvtsi128_si32(hi)), min = short(_mm_cvtsi128_si32(lo));
+    return max > -min ? max : -min;
+}
+
+void q15_window_ssse3(const short* input, const int16_t* window, int16_t* even, int16_t* odd, size_t len,
+                      int left_shift, int right_shift) {
+    const __m128i left = _mm_cvtsi32_si128(left_shift);
+    const __m128i right = shift_multiplier(right_shift);
+    // Gathers the even samples of a vector into its low half and the odd samples into its high half
+    const __m128i split = _mm_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15);
+
+    size_t i = 0;
+    for(; i + 16 <= len; i += 16) {
+        __m128i x0 = _mm_sll_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i)), left);
+        __m128i x1 = _mm_sll_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i + 8)), left);
+        x0 = _mm_mulhrs_epi16(x0, _mm_loadu_si128(reinterpret_cast<const __m128i*>(window + i)));
+        x1 = _mm_mulhrs_epi16(x1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(window + i + 8)));
+        x0 = _mm_shuffle_epi8(_mm_mulhrs_epi16(x0, right), split);
+        x1 = _mm_shuffle_epi8(_mm_mulhrs_epi16(x1, right), split);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(even + i/2), _mm_unpacklo_epi64(x0, x1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(odd + i/2), _mm_unpackhi_epi64(x0, x1));
+    }
+
+    if(i != len) q15_window_scalar(input + i, window + i, even + i/2, odd + i/2, len - i, left_shift, right_shift);
+}
+
+static int radix8_pass_ssse3(int16_t* re, int16_t* im, size_t n) {
+    // Stages m=1, 2 and 4 fused.  Eight groups of eight are transposed so that the butterflies become vertical, the
+    // twiddles are 1, -i and the two diagonals.  The input limit leaves room for the growth without a shift.
+    const __m128i c = _mm_set1_epi16(q15_sqrt_half);
+    __m128i hi = _mm_setzero_si128(), lo = _mm_setzero_si128();
+    __m128i r[8], i[8];
+    for(size_t g = 0; g < n; g += 64) {
+        for(size_t e = 0; e != 8; ++e) {
+            r[e] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(re + g + 8*e));
+            i[e] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(im + g + 8*e));
+        }
+        transpose8_epi16(r);
+        transpose8_epi16(i);
+
+        // m=1
+        for(size_t e = 0; e != 8; e += 2) {
+            const __m128i ur = r[e], ui = i[e];
+            r[e] = _mm_adds_epi16(ur, r[e+1]); i[e] = _mm_adds_epi16(ui, i[e+1]);
+            r[e+1] = _mm_subs_epi16(ur, r[e+1]); i[e+1] = _mm_subs_epi16(ui, i[e+1]);
+        }
+
+        // m=2, the second twiddle is -i
+        for(size_t e = 0; e != 8; e += 4) {
+            __m128i ur = r[e], ui = i[e];
+            r[e] = _mm_adds_epi16(ur, r[e+2]); i[e] = _mm_adds_epi16(ui, i[e+2]);
+            r[e+2] = _mm_subs_epi16(ur, r[e+2]); i[e+2] = _mm_subs_epi16(ui, i[e+2]);
+            ur = r[e+1]; ui = i[e+1];
+            const __m128i xr = r[e+3], xi = i[e+3];
+            r[e+1] = _mm_adds_epi16(ur, xi); i[e+1] = _mm_subs_epi16(ui, xr);
+            r[e+3] = _mm_subs_epi16(ur, xi); i[e+3] = _mm_adds_epi16(ui, xr);
+        }
+
+        // m=4, twiddles 1, (1 - i)/sqrt(2), -i and -(1 + i)/sqrt(2)
+        const __m128i t1r = _mm_mulhrs_epi16(_mm_adds_epi16(r[5], i[5]), c);
+        const __m128i t1i = _mm_mulhrs_epi16(_mm_subs_epi16(i[5], r[5]), c);
+        const __m128i t3r = _mm_mulhrs_epi16(_mm_subs_epi16(i[7], r[7]), c);
+        const __m128i t3i = _mm_mulhrs_epi16(_mm_adds_epi16(r[7], i[7]), _mm_sub_epi16(_mm_setzero_si128(), c));
+        const __m128i tr[4] = { r[4], t1r, i[6], t3r };
+        const __m128i ti[4] = { i[4], t1i, _mm_sub_epi16(_mm_setzero_si128(), r[6]), t3i };
+        for(size_t e = 0; e != 4; ++e) {
+            const __m128i ur = r[e], ui = i[e];
+            r[e] = _mm_adds_epi16(ur, tr[e]); i[e] = _mm_adds_epi16(ui, ti[e]);
+            r[e+4] = _mm_subs_epi16(ur, tr[e]); i[e+4] = _mm_subs_epi16(ui, ti[e]);
+        }
+
+        for(size_t e = 0; e != 8; ++e) {
+            hi = _mm_max_epi16(hi, _mm_max_epi16(r[e], i[e]));
+            lo = _mm_min_epi16(lo, _mm_min_epi16(r[e], i[e]));
+        }
+
+        transpose8_epi16(r);
+        transpose8_epi16(i);
+        for(size_t e = 0; e != 8; ++e) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(re + g + 8*e), r[e]);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(im + g + 8*e), i[e]);
+        }
+    }
+    return peak_of(hi, lo);
+}
+
+template <bool Shift>
+static int radix2_stage_ssse3(int16_t* re, int16_t* im, size_t n, size_t m, const int16_t* wr, const int16_t* wi,
+                              int shift) {
+    const __m128i scale = shift_multiplier(shift);
+    __m128i hi = _mm_setzero_si128(), lo = _mm_setzero_si128();
+    for(size_t k = 0; k < n; k += 2*m) {
+        int16_t* ar = re + k; int16_t* ai = im + k;
+        int16_t* br = ar + m; int16_t* bi = ai + m;
+        for(size_t j = 0; j < m; j += 8) {
+            const __m128i w_r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(wr + j));
+            const __m128i w_i = _mm_loadu_si128(reinterpret_cast<const __m128i*>(wi + j));
+            __m128i x_r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(br + j));
+            __m128i x_i = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bi + j));
+            __m128i u_r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ar + j));
+            __m128i u_i = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ai + j));
+            if(Shift) {
+                x_r = _mm_mulhrs_epi16(x_r, scale); x_i = _mm_mulhrs_epi16(x_i, scale);
+                u_r = _mm_mulhrs_epi16(u_r, scale); u_i = _mm_mulhrs_epi16(u_i, scale);
+            }
+
+            const __m128i tr = _mm_subs_epi16(_mm_mulhrs_epi16(x_r, w_r), _mm_mulhrs_epi16(x_i, w_i));
+            const __m128i ti = _mm_adds_epi16(_mm_mulhrs_epi16(x_r, w_i), _mm_mulhrs_epi16(x_i, w_r));
+            const __m128i o0 = _mm_adds_epi16(u_r, tr), o1 = _mm_adds_epi16(u_i, ti);
+            const __m128i o2 = _mm_subs_epi16(u_r, tr), o3 = _mm_subs_epi16(u_i, ti);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(ar + j), o0);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(ai + j), o1);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(br + j), o2);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(bi + j), o3);
+            hi = _mm_max_epi16(hi, _mm_max_epi16(_mm_max_epi16(o0, o1), _mm_max_epi16(o2, o3)));
+            lo = _mm_min_epi16(lo, _mm_min_epi16(_mm_min_epi16(o0, o1), _mm_min_epi16(o2, o3)));
+        }
+    }
+    return peak_of(hi, lo);
+}
+
+int q15_butterflies_ssse3(int16_t* re, int16_t* im, size_t n, const int16_t* tw_re, const int16_t* tw_im,
+                          int* peak) {
+    *peak = radix8_pass_ssse3(re, im, n);
+    int halvings = 0;
+    for(size_t m = 8; m < n; m <<= 1) {
+        const int shift = q15_headroom_shift(*peak, q15_stage_limit);
+        *peak = shift == 0 ? radix2_stage_ssse3<false>(re, im, n, m, tw_re + m - 1, tw_im + m - 1, 0)
+                           : radix2_stage_ssse3<true>(re, im, n, m, tw_re + m - 1, tw_im + m - 1, shift);
+        halvings += shift;
+    }
+    return halvings;
+}
+
+#endif //ZAPPLAYER_X86
@@ -0,0 +1,64 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#include "cpu_features.hpp"
+#include "fft_kernels.hpp"
+
+/*
+ * This file is built with SSE2 code generation and must only be entered after get_cpu_features() reports it, which a
+ * 32-bit build without SSE2 enabled does not assume.
+ */
+
+#if defined(ZAPPLAYER_X86)
+#include <emmintrin.h>
+
+void fft_radix4_pass_sse2(float* re, float* im, size_t n) {
+    // Stages m=1 and m=2 fused.  Four radix-4 groups are transposed so that each register holds the same element of
+    // four groups and the butterflies become purely vertical.  The m=2 twiddle is -i.
+    for(size_t g = 0; g < n; g += 16) {
+        __m128 r0 = _mm_loadu_ps(re + g), r1 = _mm_loadu_ps(re + g + 4);
+        __m128 r2 = _mm_loadu_ps(re + g + 8), r3 = _mm_loadu_ps(re + g + 12);
+        __m128 i0 = _mm_loadu_ps(im + g), i1 = _mm_loadu_ps(im + g + 4);
+        __m128 i2 = _mm_loadu_ps(im + g + 8), i3 = _mm_loadu_ps(im + g + 12);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        _MM_TRANSPOSE4_PS(i0, i1, i2, i3);
+
+        const __m128 a0r = _mm_add_ps(r0, r1), a0i = _mm_add_ps(i0, i1);
+        const __m128 a1r = _mm_sub_ps(r0, r1), a1i = _mm_sub_ps(i0, i1);
+        const __m128 a2r = _mm_add_ps(r2, r3), a2i = _mm_add_ps(i2, i3);
+        const __m128 a3r = _mm_sub_ps(r2, r3), a3i = _mm_sub_ps(i2, i3);
+
+        r0 = _mm_add_ps(a0r, a2r); i0 = _mm_add_ps(a0i, a2i);
+        r2 = _mm_sub_ps(a0r, a2r); i2 = _mm_sub_ps(a0i, a2i);
+        r1 = _mm_add_ps(a1r, a3i); i1 = _mm_sub_ps(a1i, a3r);
+        r3 = _mm_sub_ps(a1r, a3i); i3 = _mm_add_ps(a1i, a3r);
+
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        _MM_TRANSPOSE4_PS(i0, i1, i2, i3);
+        _mm_storeu_ps(re + g, r0); _mm_storeu_ps(re + g + 4, r1);
+        _mm_storeu_ps(re + g + 8, r2); _mm_storeu_ps(re + g + 12, r3);
+        _mm_storeu_ps(im + g, i0); _mm_storeu_ps(im + g + 4, i1);
+        _mm_storeu_ps(im + g + 8, i2); _mm_storeu_ps(im + g + 12, i3);
+    }
+}
+
+void fft_radix2_stage_sse2(float* re, float* im, size_t n, size_t m, const float* wr, const float* wi) {
+    for(size_t k = 0; k < n; k += 2*m) {
+        float* ar = re + k; float* ai = im + k;
+        float* br = ar + m; float* bi = ai + m;
+        for(size_t j = 0; j < m; j += 4) {
+            const __m128 w_r = _mm_loadu_ps(wr + j), w_i = _mm_loadu_ps(wi + j);
+            const __m128 x_r = _mm_loadu_ps(br + j), x_i = _mm_loadu_ps(bi + j);
+            const __m128 tr = _mm_sub_ps(_mm_mul_ps(x_r, w_r), _mm_mul_ps(x_i, w_i));
+            const __m128 ti = _mm_add_ps(_mm_mul_ps(x_r, w_i), _mm_mul_ps(x_i, w_r));
+            const __m128 u_r = _mm_loadu_ps(ar + j), u_i = _mm_loadu_ps(ai + j);
+            _mm_storeu_ps(ar + j, _mm_add_ps(u_r, tr)); _mm_storeu_ps(ai + j, _mm_add_ps(u_i, ti));
+            _mm_storeu_ps(br + j, _mm_sub_ps(u_r, tr)); _mm_storeu_ps(bi + j, _mm_sub_ps(u_i, ti));
+        }
+    }
+}
+
+void fft_butterflies_sse2(float* re, float* im, size_t n, const float* tw_re, const float* tw_im) {
+    fft_radix4_pass_sse2(re, im, n);
+    for(size_t m = 4; m < n; m <<= 1) fft_radix2_stage_sse2(re, im, n, m, tw_re + m - 1, tw_im + m - 1);
+}
+
+#endif //ZAPPLAYER_X86
@@ -0,0 +1,110 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#include "filter_bank.hpp"
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+
+constexpr double filter_pi = 3.14159265358979323846;
+
+static double hz_to_mel(double hz) { return 2595. * std::log10(1. + hz/700.); }
+static double mel_to_hz(double mel) { return 700. * (std::pow(10., mel/2595.) - 1.); }
+
+filter_bank::filter_bank(band_scale scale, size_t bands, size_t fft_size, float sample_rate, float min_frequency,
+                         float max_frequency) : scale_(scale) {
+    assert(bands > 0 && fft_size >= 4 && min_frequency > 0.f && min_frequency < max_frequency);
+
+    const size_t bin_count = fft_size/2 + 1;
+    const double hz_per_bin = double(sample_rate)/fft_size;
+    const double nyquist = .5 * sample_rate;
+    const double lo = std::min<double>(min_frequency, nyquist), hi = std::min<double>(max_frequency, nyquist);
+
+    offsets_.push_back(0);
+
+    if(scale_ == band_scale::BS_LINEAR) {
+        for(size_t b = 0; b != std::min(bands, bin_count); ++b) {
+            first_bin_.push_back(uint32_t(b));
+            weights_.push_back(1.f);
+            offsets_.push_back(uint32_t(weights_.size()));
+            centres_.push_back(float(b * hz_per_bin));
+        }
+        return;
+    }
+
+    // Band edges in Hz, band b spans edges[b] to edges[b+2] with its centre at edges[b+1]
+    std::vector<double> edges(bands + 2);
+    for(size_t i = 0; i != edges.size(); ++i) {
+        const double t = double(i)/(bands + 1);
+        if(scale_ == band_scale::BS_MEL) {
+            edges[i] = mel_to_hz(hz_to_mel(lo) + t * (hz_to_mel(hi) - hz_to_mel(lo)));
+        } else {
+            edges[i] = lo * std::pow(hi/lo, t);
+        }
+    }
+
+    // For constant-Q the bands per octave determine Q, the kernel spans one band either side of the centre
+    const double bands_per_octave = (bands + 1)/std::log2(hi/lo);
+    const double Q = 1./(std::pow(2., 1./bands_per_octave) - 1.);
+
+    std::vector<float> bin_weights(bin_count);
+    for(size_t b = 0; b != bands; ++b) {
+        const double centre = edges[b+1];
+        double lower = edges[b], upper = edges[b+2];
+        if(scale_ == band_scale::BS_CONSTANT_Q) {
+            lower = centre - centre/Q;
+            upper = centre + centre/Q;
+        }
+
+        const size_t first = size_t(std::ceil(lower/hz_per_bin));
+        const size_t last = std::min(size_t(std::floor(upper/hz_per_bin)), bin_count - 1);
+        centres_.push_back(float(centre));
+
+        size_t used = 0;
+        for(size_t k = first; k <= last && k < bin_count; ++k) {
+            const double f = k * hz_per_bin;
+            double w;
+            if(scale_ == band_scale::BS_CONSTANT_Q) {
+                w = .5 + .5 * std::cos(filter_pi * (f - centre)/(centre/Q));
+            } else {
+                w = f < centre ? (f - lower)/(centre - lower) : (upper - f)/(upper - centre);
+            }
+            bin_weights[k] = float(std::max(w, 0.));
+            if(bin_weights[k] > 0.f) ++used;
+        }
+
+        if(used < 2) add_interpolated(float(centre/hz_per_bin), bin_count);
+        else         add_band(bin_weights, first, last);
+    }
+}
+
+void filter_bank::add_band(const std::vector<float>& bin_weights, size_t first, size_t last) {
+    while(first < last && bin_weights[first] == 0.f) ++first;
+    while(last > first && bin_weights[last] == 0.f) --last;
+
+    float sum = 0.f;
+    for(size_t k = first; k <= last; ++k) sum += bin_weights[k];
+
+    first_bin_.push_back(uint32_t(first));
+    for(size_t k = first; k <= last; ++k) weights_.push_back(bin_weights[k]/sum);
+    offsets_.push_back(uint32_t(weights_.size()));
+}
+
+void filter_bank::add_interpolated(float bin, size_t bin_count) {
+    const size_t k = std::min(size_t(bin), bin_count - 2);
+    const float frac = std::min(bin - k, 1.f);
+    first_bin_.push_back(uint32_t(k));
+    weights_.push_back(1.f - frac);
+    weights_.push_back(frac);
+    offsets_.push_back(uint32_t(weights_.size()));
+}
+
+void filter_bank::apply(const float* input, float* output) const {
+    const float* w = weights_.data();
+    for(size_t b = 0, end = first_bin_.size(); b != end; ++b) {
+        const float* x = input + first_bin_[b];
+        const size_t count = offsets_[b+1] - offsets_[b];
+        float sum = 0.f;
+        for(size_t k = 0; k != count; ++k) sum += w[k] * x[k];
+        output[b] = sum;
+        w += count;
+    }
+}
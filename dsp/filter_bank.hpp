@@ -0,0 +1,53 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_FILTER_BANK_HPP
+#define ZAPPLAYER_FILTER_BANK_HPP
+
+/*
+ * Maps the fft_size/2+1 bins of a power spectrum onto a smaller number of perceptual bands with a precomputed sparse
+ * filter bank.  Each band stores a contiguous run of FFT bins and their weights (normalised to sum to one) so that a
+ * frame is reduced by a single pass over one packed weight array.
+ *
+ * BS_LINEAR        The first N FFT bins, unchanged
+ * BS_LOG           Triangular filters with centres equally spaced in log frequency
+ * BS_MEL           Triangular filters with centres equally spaced on the mel scale
+ * BS_CONSTANT_Q    Hann shaped kernels at log spaced centres with a bandwidth of f/Q (spectral kernel approximation)
+ *
+ * Bands narrower than the FFT bin spacing interpolate between the two nearest bins.
+ */
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+enum class band_scale {
+    BS_LINEAR,
+    BS_LOG,
+    BS_MEL,
+    BS_CONSTANT_Q
+};
+
+class filter_bank {
+public:
+    filter_bank(band_scale scale, size_t bands, size_t fft_size, float sample_rate, float min_frequency=30.f,
+                float max_frequency=16000.f);
+
+    band_scale scale() const { return scale_; }
+    size_t bands() const { return first_bin_.size(); }
+    size_t nonzero_weights() const { return weights_.size(); }
+    float centre_frequency(size_t band) const { return centres_[band]; }
+
+    // input holds fft_size/2+1 values, output holds bands() values
+    void apply(const float* input, float* output) const;
+
+protected:
+    void add_band(const std::vector<float>& bin_weights, size_t first, size_t last);
+    void add_interpolated(float bin, size_t bin_count);
+
+    band_scale scale_;
+    std::vector<uint32_t> first_bin_;   // First FFT bin of each band
+    std::vector<uint32_t> offsets_;     // Offset of each band's weights, bands()+1 entries
+    std::vector<float> weights_;
+    std::vector<float> centres_;        // Centre frequency of each band in Hz
+};
+
+#endif //ZAPPLAYER_FILTER_BANK_HPP
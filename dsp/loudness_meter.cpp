@@ -0,0 +1,284 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#include "loudness_meter.hpp"
+#include "cpu_features.hpp"
+#include <cmath>
+#include <limits>
+#include <cassert>
+#include <algorithm>
+
+#if defined(ZAPPLAYER_SSE2)
+#include <emmintrin.h>
+#endif
+
+constexpr double loudness_pi = 3.14159265358979323846;
+constexpr double absolute_gate = -70.;                  // LUFS
+constexpr double relative_gate = -10.;                  // LU below the mean of the blocks above the absolute gate
+constexpr double gate_bin_width = .1;                   // LU
+constexpr size_t gate_bins = 800;                       // -70 to +10 LUFS
+constexpr float s16_scale = 1.f/32768.f;
+
+static float energy_to_lufs(double energy) {
+    return energy > 0. ? float(-.691 + 10.*std::log10(energy)) : -std::numeric_limits<float>::infinity();
+}
+
+static float peak_to_db(float peak) {
+    return peak > 0.f ? 20.f*std::log10(peak) : -std::numeric_limits<float>::infinity();
+}
+
+// The BS.1770 pre-filter (a high shelf modelling the head) and RLB weighting (a high pass) redesigned for any sample
+// rate from their analogue prototypes, at 48 kHz they reproduce the coefficients tabulated in the standard
+static void k_weighting(double sample_rate, double* shelf, double* highpass) {
+    double K = std::tan(loudness_pi * 1681.974450955533/sample_rate);
+    double Q = .7071752369554196;
+    const double Vh = std::pow(10., 3.999843853973347/20.);
+    const double Vb = std::pow(Vh, .4996667741545416);
+    double a0 = 1. + K/Q + K*K;
+    shelf[0] = (Vh + Vb*K/Q + K*K)/a0;
+    shelf[1] = 2.*(K*K - Vh)/a0;
+    shelf[2] = (Vh - Vb*K/Q + K*K)/a0;
+    shelf[3] = 2.*(K*K - 1.)/a0;
+    shelf[4] = (1. - K/Q + K*K)/a0;
+
+    K = std::tan(loudness_pi * 38.13547087602444/sample_rate);
+    Q = .5003270373238773;
+    a0 = 1. + K/Q + K*K;
+    highpass[0] = 1.;
+    highpass[1] = -2.;
+    highpass[2] = 1.;
+    highpass[3] = 2.*(K*K - 1.)/a0;
+    highpass[4] = (1. - K/Q + K*K)/a0;
+}
+
+loudness_meter::loudness_meter(float sample_rate, size_t channels) : sample_rate_(sample_rate), channels_(channels),
+    lanes_((channels + 1) & ~size_t(1)), state_(4*lanes_), scratch_(chunk_frames*lanes_),
+    taps_(4*oversampling*phase_taps), history_(channels*(phase_taps - 1 + chunk_frames)),
+    subblock_frames_(size_t(std::lround(.1*sample_rate))), gate_counts_(gate_bins), gate_energy_(gate_bins) {
+    assert(channels > 0 && subblock_frames_ > 0 && "loudness_meter requires channels and a sample rate");
+
+    k_weighting(sample_rate, k_shelf_, k_highpass_);
+
+    // A Hann windowed sinc interpolating oversampling - 1 values between samples.  The taps of each phase are stored in
+    // the order of the samples they multiply (oldest first), normalised to unity gain at DC and repeated in four lanes.
+    const size_t length = oversampling*phase_taps;
+    const double centre = .5*(length - 1);
+    for(size_t p = 0; p != oversampling; ++p) {
+        double sum = 0.;
+        std::vector<double> phase(phase_taps);
+        for(size_t k = 0; k != phase_taps; ++k) {
+            const size_t j = oversampling*k + p;
+            const double x = (j - centre)/oversampling;
+            const double sinc = std::sin(loudness_pi*x)/(loudness_pi*x);
+            const double window = .5 - .5*std::cos(2.*loudness_pi*(j + .5)/length);
+            phase[k] = sinc*window;
+            sum += phase[k];
+        }
+        for(size_t k = 0; k != phase_taps; ++k) {
+            const size_t idx = 4*(oversampling*(phase_taps - 1 - k) + p);
+            std::fill(taps_.begin() + idx, taps_.begin() + idx + 4, float(phase[k]/sum));
+        }
+    }
+
+    reset();
+}
+
+void loudness_meter::reset() {
+    std::fill(state_.begin(), state_.end(), 0.);
+    std::fill(history_.begin(), history_.end(), 0.f);
+    std::fill(gate_counts_.begin(), gate_counts_.end(), 0);
+    std::fill(gate_energy_.begin(), gate_energy_.end(), 0.);
+    std::fill(subblocks_, subblocks_ + short_term_blocks, 0.);
+    subblock_fill_ = 0;
+    subblock_energy_ = 0.;
+    subblock_count_ = 0;
+    gated_blocks_ = 0;
+    gated_energy_ = 0.;
+    momentary_ = short_term_ = integrated_ = -std::numeric_limits<float>::infinity();
+    true_peak_ = block_peak_ = -std::numeric_limits<float>::infinity();
+}
+
+void loudness_meter::process(const short* input, size_t frames) {
+    process_samples(input, frames, s16_scale);
+}
+
+void loudness_meter::process(const float* input, size_t frames) {
+    process_samples(input, frames, 1.f);
+}
+
+template <typename T>
+void loudness_meter::process_samples(const T* input, size_t frames, float scale) {
+    float peak = 0.f;
+    while(frames != 0) {
+        // Chunks never straddle a sub-block so its energy is complete when the chunk ends
+        const size_t len = std::min({ frames, chunk_frames, subblock_frames_ - subblock_fill_ });
+        load_chunk(input, len, scale);
+        filter_chunk(len);
+        peak = std::max(peak, peak_chunk(len));
+
+        input += len*channels_;
+        frames -= len;
+        subblock_fill_ += len;
+        if(subblock_fill_ == subblock_frames_) end_subblock();
+    }
+
+    block_peak_ = peak_to_db(peak);
+    true_peak_ = std::max(true_peak_, block_peak_);
+}
+
+// Fills the filter scratch and appends the chunk to the interpolator's history, both at full scale 1
+template <typename T>
+void loudness_meter::load_chunk(const T* input, size_t frames, float scale) {
+    const size_t history = phase_taps - 1;
+    for(size_t c = 0; c != channels_; ++c) {
+        float* x = history_.data() + c*(history + chunk_frames) + history;
+        for(size_t i = 0; i != frames; ++i) {
+            x[i] = input[i*channels_ + c] * scale;
+            scratch_[i*lanes_ + c] = input[i*channels_ + c] * double(scale);
+        }
+    }
+}
+
+void loudness_meter::filter_chunk(size_t frames) {
+    const double* s = k_shelf_;
+    const double* h = k_highpass_;
+    double* z1a = state_.data();
+    double* z2a = z1a + lanes_;
+    double* z1b = z2a + lanes_;
+    double* z2b = z1b + lanes_;
+    double energy = 0.;
+
+#if defined(ZAPPLAYER_SSE2)
+    // Two channels per register, the padding lane of an odd channel count filters zeros
+    const __m128d sb0 = _mm_set1_pd(s[0]), sb1 = _mm_set1_pd(s[1]), sb2 = _mm_set1_pd(s[2]);
+    const __m128d sa1 = _mm_set1_pd(s[3]), sa2 = _mm_set1_pd(s[4]);
+    const __m128d ha1 = _mm_set1_pd(h[3]), ha2 = _mm_set1_pd(h[4]);
+    for(size_t l = 0; l != lanes_; l += 2) {
+        __m128d s1 = _mm_loadu_pd(z1a + l), s2 = _mm_loadu_pd(z2a + l);
+        __m128d h1 = _mm_loadu_pd(z1b + l), h2 = _mm_loadu_pd(z2b + l);
+        __m128d sum = _mm_setzero_pd();
+        for(size_t i = 0; i != frames; ++i) {
+            const __m128d x = _mm_loadu_pd(scratch_.data() + i*lanes_ + l);
+            const __m128d y = _mm_add_pd(_mm_mul_pd(sb0, x), s1);
+            s1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(sb1, x), _mm_mul_pd(sa1, y)), s2);
+            s2 = _mm_sub_pd(_mm_mul_pd(sb2, x), _mm_mul_pd(sa2, y));
+            // The high pass numerator is 1, -2, 1
+            const __m128d z = _mm_add_pd(y, h1);
+            h1 = _mm_sub_pd(_mm_sub_pd(h2, _mm_add_pd(y, y)), _mm_mul_pd(ha1, z));
+            h2 = _mm_sub_pd(y, _mm_mul_pd(ha2, z));
+            sum = _mm_add_pd(sum, _mm_mul_pd(z, z));
+        }
+        _mm_storeu_pd(z1a + l, s1); _mm_storeu_pd(z2a + l, s2);
+        _mm_storeu_pd(z1b + l, h1); _mm_storeu_pd(z2b + l, h2);
+        energy += _mm_cvtsd_f64(sum) + _mm_cvtsd_f64(_mm_unpackhi_pd(sum, sum));
+    }
+#else
+    for(size_t l = 0; l != channels_; ++l) {
+        double s1 = z1a[l], s2 = z2a[l], h1 = z1b[l], h2 = z2b[l], sum = 0.;
+        for(size_t i = 0; i != frames; ++i) {
+            const double x = scratch_[i*lanes_ + l];
+            const double y = s[0]*x + s1;
+            s1 = s[1]*x - s[3]*y + s2;
+            s2 = s[2]*x - s[4]*y;
+            const double z = h[0]*y + h1;
+            h1 = h[1]*y - h[3]*z + h2;
+            h2 = h[2]*y - h[4]*z;
+            sum += z*z;
+        }
+        z1a[l] = s1; z2a[l] = s2; z1b[l] = h1; z2b[l] = h2;
+        energy += sum;
+    }
+#endif
+
+    // The state decays towards denormals in silence, which are slow on x86
+    for(auto& v : state_) {
+        if(std::fabs(v) < 1e-30) v = 0.;
+    }
+
+    subblock_energy_ += energy;
+}
+
+float loudness_meter::peak_chunk(size_t frames) {
+    const size_t history = phase_taps - 1;
+    float peak = 0.f;
+    for(size_t c = 0; c != channels_; ++c) {
+        float* x = history_.data() + c*(history + chunk_frames);
+
+        size_t i = 0;
+#if defined(ZAPPLAYER_SSE2)
+        // Four consecutive samples in the lanes of a register, each phase accumulating its own register
+        const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+        __m128 vpeak = _mm_setzero_ps();
+        for(; i + 4 <= frames; i += 4) {
+            __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps(), acc2 = _mm_setzero_ps(), acc3 = _mm_setzero_ps();
+            for(size_t k = 0; k != phase_taps; ++k) {
+                const __m128 xk = _mm_loadu_ps(x + i + k);
+                const float* tk = taps_.data() + 4*oversampling*k;
+                acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(tk), xk));
+                acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(tk + 4), xk));
+                acc2 = _mm_add_ps(acc2, _mm_mul_ps(_mm_loadu_ps(tk + 8), xk));
+                acc3 = _mm_add_ps(acc3, _mm_mul_ps(_mm_loadu_ps(tk + 12), xk));
+            }
+            const __m128 hi = _mm_max_ps(_mm_and_ps(acc0, abs_mask), _mm_and_ps(acc1, abs_mask));
+            const __m128 lo = _mm_max_ps(_mm_and_ps(acc2, abs_mask), _mm_and_ps(acc3, abs_mask));
+            vpeak = _mm_max_ps(vpeak, _mm_max_ps(hi, lo));
+        }
+        vpeak = _mm_max_ps(vpeak, _mm_movehl_ps(vpeak, vpeak));
+        vpeak = _mm_max_ss(vpeak, _mm_shuffle_ps(vpeak, vpeak, _MM_SHUFFLE(1, 1, 1, 1)));
+        peak = std::max(peak, _mm_cvtss_f32(vpeak));
+#endif
+        for(; i != frames; ++i) {
+            for(size_t p = 0; p != oversampling; ++p) {
+                float acc = 0.f;
+                for(size_t k = 0; k != phase_taps; ++k) acc += taps_[4*(oversampling*k + p)] * x[i + k];
+                peak = std::max(peak, std::fabs(acc));
+            }
+        }
+
+        std::copy(x + frames, x + frames + history, x);
+    }
+    return peak;
+}
+
+void loudness_meter::end_subblock() {
+    subblocks_[subblock_count_ % short_term_blocks] = subblock_energy_/subblock_frames_;
+    ++subblock_count_;
+    subblock_fill_ = 0;
+    subblock_energy_ = 0.;
+
+    // Sub-blocks before the first are zero, as if the programme were preceded by silence
+    double momentary = 0., short_term = 0.;
+    for(size_t i = 0; i != momentary_blocks; ++i) {
+        momentary += subblocks_[(subblock_count_ + short_term_blocks - 1 - i) % short_term_blocks];
+    }
+    for(size_t i = 0; i != short_term_blocks; ++i) short_term += subblocks_[i];
+    momentary /= momentary_blocks;
+    short_term /= short_term_blocks;
+
+    momentary_ = energy_to_lufs(momentary);
+    short_term_ = energy_to_lufs(short_term);
+
+    // The momentary window is also the gating block, one starts every sub-block once the first is complete
+    if(subblock_count_ < momentary_blocks || !(momentary_ > absolute_gate)) return;
+
+    const double bin = std::floor((momentary_ - absolute_gate)/gate_bin_width);
+    const size_t idx = std::min(size_t(bin), gate_bins - 1);
+    ++gate_counts_[idx];
+    gate_energy_[idx] += momentary;
+    ++gated_blocks_;
+    gated_energy_ += momentary;
+    integrated_ = gated_loudness();
+}
+
+float loudness_meter::gated_loudness() const {
+    // The relative gate is resolved to the histogram's 0.1 LU bins
+    const double threshold = energy_to_lufs(gated_energy_/gated_blocks_) + relative_gate;
+    const double bin = std::floor((threshold - absolute_gate)/gate_bin_width);
+    const size_t first = bin < 0. ? 0 : std::min(size_t(bin), gate_bins - 1);
+
+    uint64_t count = 0;
+    double energy = 0.;
+    for(size_t i = first; i != gate_bins; ++i) {
+        count += gate_counts_[i];
+        energy += gate_energy_[i];
+    }
+    return count != 0 ? energy_to_lufs(energy/count) : -std::numeric_limits<float>::infinity();
+}
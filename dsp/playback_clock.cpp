@@ -0,0 +1,43 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#include "playback_clock.hpp"
+#include <algorithm>
+
+// Enough slots that a reader is not lapped by a device with very short blocks
+constexpr static size_t clock_points = 8;
+
+playback_clock::playback_clock(size_t sample_rate, float latency) : sample_rate_(sample_rate), latency_(latency),
+    delivered_(0), points_(clock_points, clock_point{0, 0, clock::time_point()}) {
+}
+
+void playback_clock::advance(size_t frames) {
+    delivered_ += frames;
+    auto& pt = points_.begin_write();
+    pt.delivered = delivered_;
+    pt.block = frames;
+    pt.time = clock::now();
+    points_.end_write();
+}
+
+void playback_clock::reset() {
+    delivered_ = 0;
+    auto& pt = points_.begin_write();
+    pt.delivered = 0;
+    pt.block = 0;
+    pt.time = clock::now();
+    points_.end_write();
+}
+
+double playback_clock::position() const {
+    clock_point pt;
+    while(true) {
+        const uint64_t count = points_.count();
+        if(count == 0) return 0.;
+        if(points_.read(count - 1, pt)) break;
+    }
+
+    // The block starts playing once the latency has passed and is assumed to play out at the nominal rate
+    const double elapsed = std::chrono::duration<double>(clock::now() - pt.time).count();
+    const double played = std::min(std::max(elapsed*sample_rate_, 0.), double(pt.block));
+    const double position = double(pt.delivered - pt.block) + played - double(get_latency())*sample_rate_;
+    return std::max(position, 0.);
+}
@@ -0,0 +1,51 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_PLAYBACK_CLOCK_HPP
+#define ZAPPLAYER_PLAYBACK_CLOCK_HPP
+
+/*
+ * Estimates which sample frame is audible now.  The last stage before the device advance()s the clock with every
+ * block it delivers, position() interpolates through the most recent block by wall time and subtracts the latency
+ * between delivery and the speaker (the device buffer and anything after it).  Positions count sample frames per
+ * channel from the last reset() and are directly comparable to bin_frame::position.
+ */
+
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include "seqlock_ring.hpp"
+
+class playback_clock {
+public:
+    using clock = std::chrono::steady_clock;
+
+    explicit playback_clock(size_t sample_rate, float latency=0.f);
+
+    size_t sample_rate() const { return sample_rate_; }
+
+    // The delay in seconds between delivering a block and hearing its first sample
+    void set_latency(float seconds) { latency_.store(seconds, std::memory_order_relaxed); }
+    float get_latency() const { return latency_.load(std::memory_order_relaxed); }
+
+    // Called by the audio thread with the number of sample frames handed to the device
+    void advance(size_t frames);
+    // Restarts the count, call when the stream is restarted and never concurrently with advance()
+    void reset();
+
+    // The estimated audible sample frame, may be fractional
+    double position() const;
+
+protected:
+    struct clock_point {
+        uint64_t delivered;                 // Sample frames delivered including the latest block
+        size_t block;                       // Sample frames in the latest block
+        clock::time_point time;             // When the latest block was delivered
+    };
+
+    size_t sample_rate_;
+    std::atomic<float> latency_;
+    uint64_t delivered_;
+    seqlock_ring<clock_point> points_;
+};
+
+#endif //ZAPPLAYER_PLAYBACK_CLOCK_HPP
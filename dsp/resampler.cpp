@@ -0,0 +1,141 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#include "resampler.hpp"
+#include "cpu_features.hpp"
+#include "spectrum_ops.hpp"
+#include <cmath>
+#include <cassert>
+#include <numeric>
+#include <algorithm>
+
+#if defined(ZAPPLAYER_SSE2)
+#include <emmintrin.h>
+#endif
+
+constexpr double resampler_pi = 3.14159265358979323846;
+constexpr double resampler_rolloff = .91;           // The cutoff as a fraction of the lower Nyquist frequency
+constexpr double resampler_beta = 8.6;              // Kaiser window, about -90 dB stop band
+
+// The zeroth order modified Bessel function of the first kind
+static double bessel_i0(double x) {
+    double sum = 1., term = 1.;
+    for(int k = 1; k != 64 && term > 1e-12*sum; ++k) {
+        const double half = x/(2.*k);
+        term *= half*half;
+        sum += term;
+    }
+    return sum;
+}
+
+static size_t gcd(size_t a, size_t b) {
+    while(b != 0) {
+        const size_t r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+resampler::resampler(size_t input_rate, size_t output_rate, size_t channels, size_t max_frames) :
+    input_rate_(input_rate), output_rate_(output_rate), channels_(channels), max_frames_(max_frames) {
+    assert(input_rate > 0 && output_rate > 0 && channels > 0 && max_frames > 0 && "resampler requires rates");
+
+    const size_t divisor = gcd(input_rate, output_rate);
+    denominator_ = output_rate/divisor;
+    step_ = input_rate/output_rate;
+    increment_ = (input_rate/divisor) % denominator_;
+
+    // The cutoff in cycles per input sample over the Nyquist frequency, the zeros of the sinc are 1/cutoff apart
+    const double cutoff = resampler_rolloff*std::min(1., double(output_rate)/input_rate);
+    const size_t half = size_t(std::ceil(zero_crossings/cutoff));
+    taps_ = (2*half + 3) & ~size_t(3);
+    capacity_ = taps_ + max_frames;
+
+    // Phase p is centred p/phases of a frame before tap taps_/2 - 1, so phase phases equals phase 0 moved by a tap
+    const double width = taps_/2.;
+    const double norm = bessel_i0(resampler_beta);
+    table_.resize((phases + 1)*taps_);
+    std::vector<double> phase(taps_);
+    for(size_t p = 0; p <= phases; ++p) {
+        const double offset = double(taps_/2 - 1) + double(p)/phases;
+        for(size_t j = 0; j != taps_; ++j) {
+            const double x = double(j) - offset;
+            const double u = x/width;
+            const double window = std::fabs(u) < 1. ? bessel_i0(resampler_beta*std::sqrt(1. - u*u))/norm : 0.;
+            const double arg = resampler_pi*cutoff*x;
+            phase[j] = (arg != 0. ? std::sin(arg)/arg : 1.)*window;
+        }
+        // Unity gain at DC for every phase
+        const double sum = std::accumulate(phase.begin(), phase.end(), 0.);
+        for(size_t j = 0; j != taps_; ++j) table_[p*taps_ + j] = float(phase[j]/sum);
+    }
+
+    history_.resize(channels_*capacity_);
+    kernel_.resize(taps_);
+    reset();
+}
+
+void resampler::reset() {
+    // The first output is centred on the first input frame
+    std::fill(history_.begin(), history_.end(), 0.f);
+    filled_ = taps_/2 - 1;
+    position_ = 0;
+    fraction_ = 0;
+}
+
+size_t resampler::process(const float* input, size_t frames, float* output) {
+    size_t count = 0;
+    for(size_t i = 0; i < frames; i += max_frames_) {
+        const size_t chunk = std::min(max_frames_, frames - i);
+        count += process_chunk(input + i*channels_, chunk, output + count*channels_);
+    }
+    return count;
+}
+
+size_t resampler::process_chunk(const float* input, size_t frames, float* output) {
+    for(size_t c = 0; c != channels_; ++c) {
+        float* history = history_.data() + c*capacity_ + filled_;
+        for(size_t i = 0; i != frames; ++i) history[i] = input[i*channels_ + c];
+    }
+    filled_ += frames;
+
+    size_t count = 0;
+    while(position_ + taps_ <= filled_) {
+        // The kernel for the offset, interpolated between the phases either side of it
+        const size_t scaled = fraction_*phases;
+        const size_t p = scaled/denominator_;
+        const float t = float(scaled - p*denominator_)/denominator_;
+        const float* a = table_.data() + p*taps_;
+        const float* b = a + taps_;
+        size_t j = 0;
+#if defined(ZAPPLAYER_SSE2)
+        const __m128 tv = _mm_set1_ps(t);
+        for(; j != taps_; j += 4) {
+            const __m128 av = _mm_loadu_ps(a + j);
+            _mm_storeu_ps(kernel_.data() + j, _mm_add_ps(av, _mm_mul_ps(tv, _mm_sub_ps(_mm_loadu_ps(b + j), av))));
+        }
+#endif
+        for(; j != taps_; ++j) kernel_[j] = a[j] + t*(b[j] - a[j]);
+
+        for(size_t c = 0; c != channels_; ++c) {
+            output[count*channels_ + c] = dot_product(kernel_.data(), history_.data() + c*capacity_ + position_, taps_);
+        }
+        ++count;
+
+        position_ += step_;
+        fraction_ += increment_;
+        if(fraction_ >= denominator_) {
+            fraction_ -= denominator_;
+            ++position_;
+        }
+    }
+
+    // Keep the frames the kernel has not yet passed, when downsampling the position may already lie beyond them
+    const size_t shift = std::min(position_, filled_);
+    for(size_t c = 0; c != channels_; ++c) {
+        float* history = history_.data() + c*capacity_;
+        std::copy(history + shift, history + filled_, history);
+    }
+    filled_ -= shift;
+    position_ -= shift;
+    return count;
+}
@@ -0,0 +1,63 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_RESAMPLER_HPP
+#define ZAPPLAYER_RESAMPLER_HPP
+
+/*
+ * Converts interleaved float blocks between any two integer sample rates with a polyphase windowed-sinc filter.  The
+ * Kaiser windowed sinc is tabulated once for phases + 1 fractional offsets, every output frame interpolates the two
+ * phases either side of its offset into one kernel that is applied to each channel with an SSE inner product, so the
+ * cost is independent of the ratio's denominator and linear in the number of taps.
+ *
+ * The cutoff sits just below the lower of the two Nyquist frequencies and the kernel spans zero_crossings zeros either
+ * side of its centre, downsampling widens the kernel in input samples to keep the transition band in place.  The
+ * position in the input is kept as an exact fraction of the two rates so long streams never drift.  Output frame n
+ * is the input at n*input_rate/output_rate, the filter looks ahead taps()/2 input frames and these are held back until
+ * they arrive.  Nothing is allocated after construction.
+ */
+
+#include <vector>
+#include <cstddef>
+
+class resampler {
+public:
+    constexpr static size_t phases = 256;
+    constexpr static size_t zero_crossings = 24;
+
+    // Input blocks are processed in pieces of up to max_frames frames
+    resampler(size_t input_rate, size_t output_rate, size_t channels, size_t max_frames=1024);
+
+    size_t input_rate() const { return input_rate_; }
+    size_t output_rate() const { return output_rate_; }
+    size_t channels() const { return channels_; }
+    size_t taps() const { return taps_; }
+
+    // The most frames process() writes for frames of input
+    size_t max_output(size_t frames) const { return frames*output_rate_/input_rate_ + 2; }
+
+    // Consumes frames interleaved frames of input and writes the output frames they complete, returns their number
+    size_t process(const float* input, size_t frames, float* output);
+
+    // Clears the input history and restarts at the first input frame
+    void reset();
+
+protected:
+    size_t process_chunk(const float* input, size_t frames, float* output);
+
+    size_t input_rate_;
+    size_t output_rate_;
+    size_t channels_;
+    size_t max_frames_;
+    size_t taps_;                       // A multiple of four
+    size_t capacity_;                   // History frames per channel
+    size_t step_;                       // Whole input frames advanced per output frame
+    size_t increment_;                  // and the fraction, over denominator_
+    size_t denominator_;
+    size_t position_;                   // The history frame under the first tap of the next output
+    size_t fraction_;                   // The offset from it, over denominator_
+    size_t filled_;                     // History frames per channel
+    std::vector<float> table_;          // The taps of phase p at p*taps_
+    std::vector<float> history_;        // Per channel, the input not yet passed by the kernel
+    std::vector<float> kernel_;
+};
+
+#endif //ZAPPLAYER_RESAMPLER_HPP
@@ -0,0 +1,220 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#include "sample_ops.hpp"
+#include "cpu_features.hpp"
+#include <cmath>
+#include <algorithm>
+
+#if defined(ZAPPLAYER_SSE2)
+#include <emmintrin.h>
+#endif
+
+void deinterleave_s16(const short* input, short* const* outputs, size_t channels, size_t frames) {
+    if(channels != 2) {
+        for(size_t i = 0; i != frames; ++i, input += channels) {
+            for(size_t c = 0; c != channels; ++c) outputs[c][i] = input[c];
+        }
+        return;
+    }
+
+    short* left = outputs[0];
+    short* right = outputs[1];
+    size_t i = 0;
+#if defined(ZAPPLAYER_SSE2)
+    for(; i + 8 <= frames; i += 8) {
+        // L0 R0 L1 R1 L2 R2 L3 R3 -> L0 L1 R0 R1 L2 L3 R2 R3 -> L0 L1 L2 L3 R0 R1 R2 R3
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + 2*i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + 2*i + 8));
+        a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(a, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+        b = _mm_shufflehi_epi16(_mm_shufflelo_epi16(b, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+        a = _mm_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 2, 0));
+        b = _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(left + i), _mm_unpacklo_epi64(a, b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(right + i), _mm_unpackhi_epi64(a, b));
+    }
+#endif
+    for(; i != frames; ++i) {
+        left[i] = input[2*i];
+        right[i] = input[2*i + 1];
+    }
+}
+
+void s16_to_float(const short* input, float* output, size_t len, float scale) {
+    size_t i = 0;
+#if defined(ZAPPLAYER_SSE2)
+    const __m128 s = _mm_set1_ps(scale);
+    for(; i + 8 <= len; i += 8) {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+        _mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), s));
+        _mm_storeu_ps(output + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), s));
+    }
+#endif
+    for(; i != len; ++i) output[i] = scale * input[i];
+}
+
+void float_to_s16(const float* input, short* output, size_t len, float scale) {
+    size_t i = 0;
+#if defined(ZAPPLAYER_SSE2)
+    // Clamping before the conversion keeps values beyond the int32 range from wrapping to INT_MIN
+    const __m128 s = _mm_set1_ps(scale);
+    const __m128 lo = _mm_set1_ps(-32768.f), hi = _mm_set1_ps(32767.f);
+    for(; i + 8 <= len; i += 8) {
+        const __m128 x0 = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(input + i), s), lo), hi);
+        const __m128 x1 = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(input + i + 4), s), lo), hi);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i),
+                         _mm_packs_epi32(_mm_cvtps_epi32(x0), _mm_cvtps_epi32(x1)));
+    }
+#endif
+    for(; i != len; ++i) output[i] = short(std::nearbyint(std::min(std::max(scale*input[i], -32768.f), 32767.f)));
+}
+
+void float_to_s16_dither(const float* input, short* output, size_t len, float scale, uint32_t* state) {
+    size_t i = 0;
+#if defined(ZAPPLAYER_SSE2)
+    // The four generators run in the lanes of a register, two steps per four samples
+    const __m128 s = _mm_set1_ps(scale);
+    const __m128 lo = _mm_set1_ps(-32768.f), hi = _mm_set1_ps(32767.f);
+    const __m128 unit = _mm_set1_ps(1.f/16777216.f);
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state));
+    auto next = [&x, unit]() {
+        x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+        x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+        x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+        return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(x, 8)), unit);
+    };
+    for(; i + 8 <= len; i += 8) {
+        const __m128 d0 = _mm_sub_ps(next(), next());
+        const __m128 d1 = _mm_sub_ps(next(), next());
+        const __m128 x0 = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(input + i), s), d0), lo), hi);
+        const __m128 x1 = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(input + i + 4), s), d1), lo), hi);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i),
+                         _mm_packs_epi32(_mm_cvtps_epi32(x0), _mm_cvtps_epi32(x1)));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), x);
+#endif
+    for(; i != len; ++i) {
+        uint32_t& x = state[i & 3];
+        float u[2];
+        for(auto& v : u) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            v = float(x >> 8)/16777216.f;
+        }
+        const float value = std::nearbyint(scale*input[i] + u[0] - u[1]);
+        output[i] = short(std::min(std::max(value, -32768.f), 32767.f));
+    }
+}
+
+void gain_ramp_s16(short* samples, size_t channels, size_t frames, const float* start, const float* end) {
+    if(frames == 0) return;
+
+    // The gain of frame f is start + step*f, the last frame receives end exactly
+    const float inv = frames > 1 ? 1.f/(frames - 1) : 0.f;
+    const size_t len = channels*frames;
+    size_t i = 0;
+#if defined(ZAPPLAYER_SSE2)
+    if(8 % channels == 0) {
+        // Eight samples per iteration cover 8/channels frames, every lane keeps its channel
+        float base[8], step[8];
+        for(size_t l = 0; l != 8; ++l) {
+            const size_t c = l % channels;
+            step[l] = (end[c] - start[c])*inv;
+            base[l] = start[c] + step[l]*(l/channels);
+        }
+        const __m128 base0 = _mm_loadu_ps(base), base1 = _mm_loadu_ps(base + 4);
+        const __m128 step0 = _mm_loadu_ps(step), step1 = _mm_loadu_ps(step + 4);
+        for(; i + 8 <= len; i += 8) {
+            const __m128 frame = _mm_set1_ps(float(i/channels));
+            const __m128 g0 = _mm_add_ps(base0, _mm_mul_ps(step0, frame));
+            const __m128 g1 = _mm_add_ps(base1, _mm_mul_ps(step1, frame));
+            const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+            // Sign extend by placing each sample in the high half of a 32 bit lane
+            const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+            const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+            const __m128i y0 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(lo), g0));
+            const __m128i y1 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(hi), g1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(samples + i), _mm_packs_epi32(y0, y1));
+        }
+    }
+#endif
+    for(; i != len; ++i) {
+        const size_t c = i % channels;
+        const float gain = start[c] + (end[c] - start[c])*inv*float(i/channels);
+        const float value = std::nearbyint(samples[i]*gain);
+        samples[i] = short(std::min(std::max(value, -32768.f), 32767.f));
+    }
+}
+
+void gain_ramp(float* samples, size_t channels, size_t frames, const float* start, const float* end) {
+    if(frames == 0) return;
+
+    const float inv = frames > 1 ? 1.f/(frames - 1) : 0.f;
+    const size_t len = channels*frames;
+    size_t i = 0;
+#if defined(ZAPPLAYER_SSE2)
+    if(4 % channels == 0) {
+        float base[4], step[4];
+        for(size_t l = 0; l != 4; ++l) {
+            const size_t c = l % channels;
+            step[l] = (end[c] - start[c])*inv;
+            base[l] = start[c] + step[l]*(l/channels);
+        }
+        const __m128 base0 = _mm_loadu_ps(base), step0 = _mm_loadu_ps(step);
+        for(; i + 4 <= len; i += 4) {
+            const __m128 gain = _mm_add_ps(base0, _mm_mul_ps(step0, _mm_set1_ps(float(i/channels))));
+            _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), gain));
+        }
+    }
+#endif
+    for(; i != len; ++i) {
+        const size_t c = i % channels;
+        samples[i] *= start[c] + (end[c] - start[c])*inv*float(i/channels);
+    }
+}
+
+void crossfade(const float* from, const float* to, float* output, size_t channels, size_t frames,
+               const float* from_gains, const float* to_gains) {
+    size_t f = 0;
+#if defined(ZAPPLAYER_SSE2)
+    if(channels == 2) {
+        // Four frames per iteration, each frame's gains repeated for its left and right samples
+        for(; f + 4 <= frames; f += 4) {
+            const __m128 a = _mm_loadu_ps(from_gains + f), b = _mm_loadu_ps(to_gains + f);
+            const __m128 x0 = _mm_loadu_ps(from + 2*f), x1 = _mm_loadu_ps(from + 2*f + 4);
+            const __m128 y0 = _mm_loadu_ps(to + 2*f), y1 = _mm_loadu_ps(to + 2*f + 4);
+            _mm_storeu_ps(output + 2*f, _mm_add_ps(_mm_mul_ps(x0, _mm_unpacklo_ps(a, a)),
+                                                   _mm_mul_ps(y0, _mm_unpacklo_ps(b, b))));
+            _mm_storeu_ps(output + 2*f + 4, _mm_add_ps(_mm_mul_ps(x1, _mm_unpackhi_ps(a, a)),
+                                                       _mm_mul_ps(y1, _mm_unpackhi_ps(b, b))));
+        }
+    }
+#endif
+    for(; f != frames; ++f) {
+        for(size_t c = 0; c != channels; ++c) {
+            const size_t i = f*channels + c;
+            output[i] = from[i]*from_gains[f] + to[i]*to_gains[f];
+        }
+    }
+}
+
+float mean_square(const float* samples, size_t len) {
+    if(len == 0) return 0.f;
+
+    size_t i = 0;
+    float sum = 0.f;
+#if defined(ZAPPLAYER_SSE2)
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    for(; i + 8 <= len; i += 8) {
+        const __m128 lo = _mm_loadu_ps(samples + i), hi = _mm_loadu_ps(samples + i + 4);
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(lo, lo));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(hi, hi));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+    sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+    for(; i != len; ++i) sum += samples[i]*samples[i];
+    return sum/len;
+}
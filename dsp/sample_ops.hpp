@@ -0,0 +1,43 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_SAMPLE_OPS_HPP
+#define ZAPPLAYER_SAMPLE_OPS_HPP
+
+/*
+ * Kernels on interleaved PCM sample blocks.
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+// Splits frames interleaved sample frames of channels samples each into one array per channel, outputs[c][i] is
+// input[i*channels + c].  Stereo is vectorised.
+void deinterleave_s16(const short* input, short* const* outputs, size_t channels, size_t frames);
+
+// output[i] = scale * input[i]
+void s16_to_float(const short* input, float* output, size_t len, float scale);
+
+// output[i] = scale * input[i] rounded to nearest and saturated to s16
+void float_to_s16(const float* input, short* output, size_t len, float scale);
+
+// float_to_s16 with TPDF dither: the difference of two uniform values in [0, 1) LSB is added before rounding, which
+// decorrelates the rounding error from the signal at the cost of a flat noise floor.  state holds four xorshift32
+// generators that must be seeded non-zero.
+void float_to_s16_dither(const float* input, short* output, size_t len, float scale, uint32_t* state);
+
+// Scales frames interleaved sample frames in place by per-channel gains ramped linearly from start[c] on the first
+// frame to end[c] on the last, rounding to nearest and saturating.  Equal start and end gains apply a constant gain.
+// Mono, stereo and four channels are vectorised.
+void gain_ramp_s16(short* samples, size_t channels, size_t frames, const float* start, const float* end);
+
+// gain_ramp_s16 on float samples, without rounding or saturation
+void gain_ramp(float* samples, size_t channels, size_t frames, const float* start, const float* end);
+
+// output[i] = from[i]*from_gains[f] + to[i]*to_gains[f] for the frame f of sample i.  output may alias either input.
+// Stereo is vectorised.
+void crossfade(const float* from, const float* to, float* output, size_t channels, size_t frames,
+               const float* from_gains, const float* to_gains);
+
+// The mean of the squared samples
+float mean_square(const float* samples, size_t len);
+
+#endif //ZAPPLAYER_SAMPLE_OPS_HPP
@@ -0,0 +1,68 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_SEQLOCK_RING_HPP
+#define ZAPPLAYER_SEQLOCK_RING_HPP
+
+/*
+ * A history of the last capacity values written by one producer thread.  Every slot is guarded by its own sequence
+ * so the producer never waits and any number of readers may copy a value out by its index, a read fails rather than
+ * returning a value torn by a concurrent write or one that has already been overwritten.
+ *
+ * T is copied by assignment while the producer may be writing it, so T must not reallocate on assignment (vectors
+ * must keep their size).
+ */
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+template <typename T>
+class seqlock_ring {
+public:
+    seqlock_ring(size_t capacity, const T& init) : capacity_(capacity), slots_(new slot[capacity]), count_(0) {
+        for(size_t i = 0; i != capacity_; ++i) {
+            slots_[i].sequence.store(0, std::memory_order_relaxed);
+            slots_[i].value = init;
+        }
+    }
+
+    size_t capacity() const { return capacity_; }
+
+    // Producer side, fill the slot returned by begin_write() and then call end_write()
+    T& begin_write() {
+        auto& s = slots_[count_.load(std::memory_order_relaxed) % capacity_];
+        s.sequence.store(2*count_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        return s.value;
+    }
+
+    void end_write() {
+        const uint64_t count = count_.load(std::memory_order_relaxed);
+        slots_[count % capacity_].sequence.store(2*count + 2, std::memory_order_release);
+        count_.store(count + 1, std::memory_order_release);
+    }
+
+    // Consumer side, the number of values written so far, value i is readable until value i + capacity is written
+    uint64_t count() const { return count_.load(std::memory_order_acquire); }
+
+    bool read(uint64_t index, T& output) const {
+        const auto& s = slots_[index % capacity_];
+        const uint64_t expected = 2*index + 2;
+        if(s.sequence.load(std::memory_order_acquire) != expected) return false;
+        output = s.value;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return s.sequence.load(std::memory_order_relaxed) == expected;
+    }
+
+protected:
+    struct slot {
+        std::atomic<uint64_t> sequence;         // 2*index + 1 while value index is written, 2*index + 2 after
+        T value;
+    };
+
+    size_t capacity_;
+    std::unique_ptr<slot[]> slots_;
+    std::atomic<uint64_t> count_;
+};
+
+#endif //ZAPPLAYER_SEQLOCK_RING_HPP
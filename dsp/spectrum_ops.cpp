@@ -0,0 +1,196 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#include "spectrum_ops.hpp"
+#include "cpu_features.hpp"
+#include <cmath>
+#include <algorithm>
+
+#if defined(ZAPPLAYER_SSE2)
+#include <emmintrin.h>
+#endif
+
+constexpr float db_power_floor = 1e-20f;
+constexpr float db_per_log2 = 3.01029995664f;        // 10*log10(2)
+
+// Triangular smoothing function, newest frame first
+constexpr static float tri_smooth[spectral_smoother::taps] = { 1.f/9.f, 2.f/9.f, 3.f/9.f, 2.f/9.f, 1.f/9.f };
+
+void power_spectrum(const float* re, const float* im, float* power, size_t len, float scale) {
+    size_t i = 0;
+#if defined(ZAPPLAYER_SSE2)
+    const __m128 s = _mm_set1_ps(scale);
+    for(; i + 4 <= len; i += 4) {
+        const __m128 r = _mm_loadu_ps(re + i), m = _mm_loadu_ps(im + i);
+        _mm_storeu_ps(power + i, _mm_mul_ps(s, _mm_add_ps(_mm_mul_ps(r, r), _mm_mul_ps(m, m))));
+    }
+#endif
+    for(; i != len; ++i) power[i] = scale * (re[i] * re[i] + im[i] * im[i]);
+}
+
+void mid_side(float* x_re, float* x_im, float* y_re, float* y_im, size_t len) {
+    size_t i = 0;
+#if defined(ZAPPLAYER_SSE2)
+    const __m128 h = _mm_set1_ps(.5f);
+    for(; i + 4 <= len; i += 4) {
+        const __m128 xr = _mm_loadu_ps(x_re + i), xi = _mm_loadu_ps(x_im + i);
+        const __m128 yr = _mm_loadu_ps(y_re + i), yi = _mm_loadu_ps(y_im + i);
+        _mm_storeu_ps(x_re + i, _mm_mul_ps(h, _mm_add_ps(xr, yr)));
+        _mm_storeu_ps(x_im + i, _mm_mul_ps(h, _mm_add_ps(xi, yi)));
+        _mm_storeu_ps(y_re + i, _mm_mul_ps(h, _mm_sub_ps(xr, yr)));
+        _mm_storeu_ps(y_im + i, _mm_mul_ps(h, _mm_sub_ps(xi, yi)));
+    }
+#endif
+    for(; i != len; ++i) {
+        const float xr = x_re[i], xi = x_im[i], yr = y_re[i], yi = y_im[i];
+        x_re[i] = .5f*(xr + yr); x_im[i] = .5f*(xi + yi);
+        y_re[i] = .5f*(xr - yr); y_im[i] = .5f*(xi - yi);
+    }
+}
+
+float stereo_width(const float* x_re, const float* x_im, const float* y_re, const float* y_im, size_t len) {
+    float mid = 0.f, side = 0.f;
+    size_t i = 0;
+#if defined(ZAPPLAYER_SSE2)
+    __m128 m = _mm_setzero_ps(), d = _mm_setzero_ps();
+    for(; i + 4 <= len; i += 4) {
+        const __m128 xr = _mm_loadu_ps(x_re + i), xi = _mm_loadu_ps(x_im + i);
+        const __m128 yr = _mm_loadu_ps(y_re + i), yi = _mm_loadu_ps(y_im + i);
+        const __m128 sr = _mm_add_ps(xr, yr), si = _mm_add_ps(xi, yi);
+        const __m128 dr = _mm_sub_ps(xr, yr), di = _mm_sub_ps(xi, yi);
+        m = _mm_add_ps(m, _mm_add_ps(_mm_mul_ps(sr, sr), _mm_mul_ps(si, si)));
+        d = _mm_add_ps(d, _mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(di, di)));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, m);
+    mid = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm_storeu_ps(lanes, d);
+    side = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for(; i != len; ++i) {
+        const float sr = x_re[i] + y_re[i], si = x_im[i] + y_im[i];
+        const float dr = x_re[i] - y_re[i], di = x_im[i] - y_im[i];
+        mid += sr * sr + si * si;
+        side += dr * dr + di * di;
+    }
+
+    const float total = mid + side;
+    return total > db_power_floor ? side/total : 0.f;
+}
+
+#if defined(ZAPPLAYER_SSE2)
+// log2(x) = e + p(m)*(m - 1) for x = m*2^e, m in [1, 2), with a degree 5 minimax polynomial for p
+static inline __m128 log2_ps(__m128 x) {
+    const __m128i bits = _mm_castps_si128(x);
+    const __m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+    const __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)),
+                                                   _mm_set1_epi32(0x3F800000)));
+    __m128 p = _mm_set1_ps(-3.4436006e-2f);
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(3.1821337e-1f));
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(-1.2315303f));
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(2.5988452f));
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(-3.3241990f));
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(3.1157899f));
+    return _mm_add_ps(_mm_mul_ps(p, _mm_sub_ps(m, _mm_set1_ps(1.f))), e);
+}
+#endif
+
+void power_to_db(const float* power, float* db, size_t len) {
+    size_t i = 0;
+#if defined(ZAPPLAYER_SSE2)
+    const __m128 floor = _mm_set1_ps(db_power_floor), k = _mm_set1_ps(db_per_log2);
+    for(; i + 4 <= len; i += 4) {
+        _mm_storeu_ps(db + i, _mm_mul_ps(k, log2_ps(_mm_max_ps(_mm_loadu_ps(power + i), floor))));
+    }
+#endif
+    for(; i != len; ++i) db[i] = 10.f * std::log10(std::max(power[i], db_power_floor));
+}
+
+void normalise_db(const float* db, float* output, size_t len, float min_db, float max_db) {
+    const float inv_range = 1.f/(max_db - min_db);
+    size_t i = 0;
+#if defined(ZAPPLAYER_SSE2)
+    const __m128 lo = _mm_set1_ps(min_db), hi = _mm_set1_ps(max_db), s = _mm_set1_ps(inv_range);
+    for(; i + 4 <= len; i += 4) {
+        const __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(db + i), lo), hi);
+        _mm_storeu_ps(output + i, _mm_mul_ps(_mm_sub_ps(v, lo), s));
+    }
+#endif
+    for(; i != len; ++i) output[i] = (std::min(std::max(db[i], min_db), max_db) - min_db) * inv_range;
+}
+
+void complex_multiply_accumulate(const float* x_re, const float* x_im, const float* h_re, const float* h_im,
+                                 float* acc_re, float* acc_im, size_t len) {
+    size_t i = 0;
+#if defined(ZAPPLAYER_SSE2)
+    for(; i + 4 <= len; i += 4) {
+        const __m128 xr = _mm_loadu_ps(x_re + i), xi = _mm_loadu_ps(x_im + i);
+        const __m128 hr = _mm_loadu_ps(h_re + i), hi = _mm_loadu_ps(h_im + i);
+        const __m128 re = _mm_sub_ps(_mm_mul_ps(xr, hr), _mm_mul_ps(xi, hi));
+        const __m128 im = _mm_add_ps(_mm_mul_ps(xr, hi), _mm_mul_ps(xi, hr));
+        _mm_storeu_ps(acc_re + i, _mm_add_ps(_mm_loadu_ps(acc_re + i), re));
+        _mm_storeu_ps(acc_im + i, _mm_add_ps(_mm_loadu_ps(acc_im + i), im));
+    }
+#endif
+    for(; i != len; ++i) {
+        acc_re[i] += x_re[i]*h_re[i] - x_im[i]*h_im[i];
+        acc_im[i] += x_re[i]*h_im[i] + x_im[i]*h_re[i];
+    }
+}
+
+float dot_product(const float* a, const float* b, size_t len) {
+    size_t i = 0;
+    float sum = 0.f;
+#if defined(ZAPPLAYER_SSE2)
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    for(; i + 8 <= len; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+    sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+    for(; i != len; ++i) sum += a[i] * b[i];
+    return sum;
+}
+
+float smoothing_coefficient(float seconds, float frame_rate) {
+    if(seconds <= 0.f) return 1.f;
+    return 1.f - std::exp(-1.f/(seconds * frame_rate));
+}
+
+spectral_smoother::spectral_smoother(size_t bins, float attack, float release) : bins_(bins), head_(0),
+    history_(taps*bins, -100.f), envelope_(bins, -100.f), attack_(attack), release_(release) {
+}
+
+void spectral_smoother::process(const float* input, float* output) {
+    head_ = (head_ + taps - 1) % taps;
+    std::copy(input, input + bins_, history_.begin() + head_*bins_);
+
+    const float* rows[taps];
+    for(size_t k = 0; k != taps; ++k) rows[k] = history_.data() + ((head_ + k) % taps)*bins_;
+
+    size_t i = 0;
+#if defined(ZAPPLAYER_SSE2)
+    const __m128 att = _mm_set1_ps(attack_), rel = _mm_set1_ps(release_);
+    for(; i + 4 <= bins_; i += 4) {
+        __m128 acc = _mm_mul_ps(_mm_set1_ps(tri_smooth[0]), _mm_loadu_ps(rows[0] + i));
+        for(size_t k = 1; k != taps; ++k) {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(tri_smooth[k]), _mm_loadu_ps(rows[k] + i)));
+        }
+        const __m128 env = _mm_loadu_ps(envelope_.data() + i);
+        const __m128 delta = _mm_sub_ps(acc, env);
+        const __m128 rising = _mm_cmpgt_ps(delta, _mm_setzero_ps());
+        const __m128 coef = _mm_or_ps(_mm_and_ps(rising, att), _mm_andnot_ps(rising, rel));
+        const __m128 result = _mm_add_ps(env, _mm_mul_ps(coef, delta));
+        _mm_storeu_ps(envelope_.data() + i, result);
+        _mm_storeu_ps(output + i, result);
+    }
+#endif
+    for(; i != bins_; ++i) {
+        float acc = 0.f;
+        for(size_t k = 0; k != taps; ++k) acc += tri_smooth[k] * rows[k][i];
+        const float delta = acc - envelope_[i];
+        envelope_[i] += (delta > 0.f ? attack_ : release_) * delta;
+        output[i] = envelope_[i];
+    }
+}
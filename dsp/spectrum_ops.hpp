@@ -0,0 +1,63 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_SPECTRUM_OPS_HPP
+#define ZAPPLAYER_SPECTRUM_OPS_HPP
+
+/*
+ * Batched post-processing of transformed frames: squared magnitudes, dB conversion of power with a vectorised log2
+ * approximation (max error below 0.001 dB), and temporal smoothing over a circular SoA history so that no bin data is
+ * shifted per frame.
+ */
+
+#include <vector>
+#include <cstddef>
+
+// power[i] = scale * (re[i]^2 + im[i]^2)
+void power_spectrum(const float* re, const float* im, float* power, size_t len, float scale);
+
+// db[i] = 10*log10(max(power[i], 1e-20))
+void power_to_db(const float* power, float* db, size_t len);
+
+// output[i] = (clamp(db[i], min_db, max_db) - min_db)/(max_db - min_db)
+void normalise_db(const float* db, float* output, size_t len, float min_db, float max_db);
+
+// Converts the left (x) and right (y) spectra in place into mid (x + y)/2 and side (x - y)/2 spectra
+void mid_side(float* x_re, float* x_im, float* y_re, float* y_im, size_t len);
+
+// The side power over the total mid and side power of two spectra: 0 for mono, .5 for uncorrelated channels of equal
+// power and 1 for channels in antiphase.  Silence returns 0.
+float stereo_width(const float* x_re, const float* x_im, const float* y_re, const float* y_im, size_t len);
+
+// acc[i] += x[i]*h[i] on complex values in split form
+void complex_multiply_accumulate(const float* x_re, const float* x_im, const float* h_re, const float* h_im,
+                                 float* acc_re, float* acc_im, size_t len);
+
+// Sum of a[i]*b[i]
+float dot_product(const float* a, const float* b, size_t len);
+
+// The one-pole coefficient for a time constant in seconds at the given frame rate, 0 seconds gives 1 (no smoothing)
+float smoothing_coefficient(float seconds, float frame_rate);
+
+class spectral_smoother {
+public:
+    constexpr static size_t taps = 5;
+
+    // attack and release are one-pole coefficients in (0, 1] applied to rising and falling values respectively
+    explicit spectral_smoother(size_t bins, float attack=1.f, float release=1.f);
+
+    size_t bins() const { return bins_; }
+    void set_coefficients(float attack, float release) { attack_ = attack; release_ = release; }
+
+    // Adds a frame to the history and writes the triangular FIR of the last taps frames, followed by the
+    // attack/release envelope, to output
+    void process(const float* input, float* output);
+
+protected:
+    size_t bins_;
+    size_t head_;                       // Row of the history holding the newest frame
+    std::vector<float> history_;        // taps rows of bins values
+    std::vector<float> envelope_;
+    float attack_;
+    float release_;
+};
+
+#endif //ZAPPLAYER_SPECTRUM_OPS_HPP
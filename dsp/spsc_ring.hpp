@@ -0,0 +1,68 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_SPSC_RING_HPP
+#define ZAPPLAYER_SPSC_RING_HPP
+
+/*
+ * A lock-free single-producer/single-consumer ring buffer.  One thread may write and one other thread may read
+ * concurrently without locks or allocation.  The capacity is rounded up to a power of two.
+ */
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+
+template <typename T>
+class spsc_ring {
+public:
+    explicit spsc_ring(size_t capacity) : buffer_(round_up(capacity)), mask_(buffer_.size() - 1), head_(0),
+        tail_(0) { }
+
+    size_t capacity() const { return buffer_.size(); }
+
+    // Producer side
+    size_t write_available() const {
+        return capacity() - (head_.load(std::memory_order_relaxed) - tail_.load(std::memory_order_acquire));
+    }
+
+    size_t write(const T* data, size_t len) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        const size_t count = std::min(len, capacity() - (head - tail_.load(std::memory_order_acquire)));
+        const size_t start = head & mask_, first = std::min(count, capacity() - start);
+        std::copy(data, data + first, buffer_.begin() + start);
+        std::copy(data + first, data + count, buffer_.begin());
+        head_.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer side
+    size_t read_available() const {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_relaxed);
+    }
+
+    size_t read(T* data, size_t len) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        const size_t count = std::min(len, head_.load(std::memory_order_acquire) - tail);
+        const size_t start = tail & mask_, first = std::min(count, capacity() - start);
+        std::copy(buffer_.begin() + start, buffer_.begin() + start + first, data);
+        std::copy(buffer_.begin(), buffer_.begin() + (count - first), data + first);
+        tail_.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+protected:
+    static size_t round_up(size_t n) {
+        size_t p = 1;
+        while(p < n) p <<= 1;
+        return p;
+    }
+
+    std::vector<T> buffer_;
+    const size_t mask_;
+    char pad0_[64];
+    std::atomic<size_t> head_;      // Written by the producer only
+    char pad1_[64];                 // Keeps head_ and tail_ on separate cache lines
+    std::atomic<size_t> tail_;      // Written by the consumer only
+};
+
+#endif //ZAPPLAYER_SPSC_RING_HPP
@@ -0,0 +1,123 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#include "stft.hpp"
+#include "window.hpp"
+#include "sample_ops.hpp"
+#include <limits>
+#include <cassert>
+#include <algorithm>
+
+constexpr float stft_s16_inv = 1.f/std::numeric_limits<short>::max();
+// Blocks with up to this many channels are split with deinterleave_s16
+constexpr static size_t max_split_channels = 8;
+
+static size_t next_pow2(size_t n) {
+    size_t p = 1;
+    while(p < n) p <<= 1;
+    return p;
+}
+
+stft::stft(size_t fft_size, size_t hop_size, size_t channels) : fft_size_(fft_size), hop_size_(hop_size),
+    channels_(channels), stride_(next_pow2(fft_size)), history_(channels*stride_, 0), rows_(channels),
+    mask_(stride_ - 1), write_(0), phase_(0), pending_(hop_size), position_(0) {
+    assert(hop_size > 0 && hop_size <= fft_size && channels > 0 && "Invalid stft configuration");
+    for(size_t c = 0; c != channels_; ++c) rows_[c] = history_.data() + c*stride_;
+}
+
+size_t stft::push(const short* samples, size_t len) {
+    size_t i = 0;
+
+    // Complete a sample frame that was split across blocks
+    while(phase_ != 0 && i != len) push_sample(samples[i++]);
+    if(frame_ready()) return i;
+
+    // Whole sample frames are split into the channel histories in at most two runs
+    size_t frames = std::min((len - i)/channels_, pending_);
+    pending_ -= frames;
+    position_ += frames;
+    short* rows[max_split_channels];
+    while(frames != 0) {
+        const size_t run = std::min(frames, stride_ - write_);
+        if(channels_ <= max_split_channels) {
+            for(size_t c = 0; c != channels_; ++c) rows[c] = rows_[c] + write_;
+            deinterleave_s16(samples + i, rows, channels_, run);
+        } else {
+            for(size_t f = 0; f != run; ++f) {
+                for(size_t c = 0; c != channels_; ++c) rows_[c][write_ + f] = samples[i + f*channels_ + c];
+            }
+        }
+        write_ = (write_ + run) & mask_;
+        i += run*channels_;
+        frames -= run;
+    }
+    if(frame_ready()) return i;
+
+    // Fewer than channels_ samples remain, they start a sample frame that the next block completes
+    while(i != len) push_sample(samples[i++]);
+    return i;
+}
+
+void stft::push_sample(short sample) {
+    rows_[phase_][write_] = sample;
+    if(++phase_ == channels_) {
+        phase_ = 0;
+        write_ = (write_ + 1) & mask_;
+        --pending_;
+        ++position_;
+    }
+}
+
+void stft::extract(float* output, const float* window, size_t size, size_t delay, size_t channel) const {
+    assert(size + delay <= fft_size_ && "Frame exceeds the stft history");
+    assert((channel < channels_ || channel == mix_channels) && "Invalid channel");
+    // The frame spans at most two contiguous runs of the history
+    const size_t start = (write_ - delay - size) & mask_;
+    const size_t first = std::min(size, stride_ - start);
+    if(channel != mix_channels || channels_ == 1) {
+        const short* row = rows_[channel == mix_channels ? 0 : channel];
+        apply_window_s16(row + start, window, output, first, stft_s16_inv);
+        apply_window_s16(row, window + first, output + first, size - first, stft_s16_inv);
+        return;
+    }
+
+    const float scale = stft_s16_inv/channels_;
+    apply_window_s16(rows_[0] + start, window, output, first, scale);
+    apply_window_s16(rows_[0], window + first, output + first, size - first, scale);
+    for(size_t c = 1; c != channels_; ++c) {
+        accumulate_window_s16(rows_[c] + start, window, output, first, scale);
+        accumulate_window_s16(rows_[c], window + first, output + first, size - first, scale);
+    }
+}
+
+void stft::extract_s16(short* output, size_t size, size_t delay, size_t channel) const {
+    assert(size + delay <= fft_size_ && "Frame exceeds the stft history");
+    assert((channel < channels_ || channel == mix_channels) && "Invalid channel");
+    const size_t start = (write_ - delay - size) & mask_;
+    const size_t first = std::min(size, stride_ - start);
+    if(channel != mix_channels || channels_ == 1) {
+        const short* row = rows_[channel == mix_channels ? 0 : channel];
+        std::copy(row + start, row + start + first, output);
+        std::copy(row, row + size - first, output + first);
+        return;
+    }
+
+    const int channels = int(channels_);
+    for(size_t i = 0; i != size; ++i) {
+        const size_t idx = (start + i) & mask_;
+        int sum = 0;
+        for(size_t c = 0; c != channels_; ++c) sum += rows_[c][idx];
+        output[i] = short(sum/channels);
+    }
+}
+
+float stft::mean_square(size_t size) const {
+    assert(size <= fft_size_ && size > 0 && "Mean square exceeds the stft history");
+    const size_t start = (write_ - size) & mask_;
+    const size_t first = std::min(size, stride_ - start);
+    double sum = 0.;
+    for(size_t c = 0; c != channels_; ++c) {
+        const short* row = rows_[c];
+        for(size_t i = start; i != start + first; ++i) sum += double(row[i])*row[i];
+        for(size_t i = 0; i != size - first; ++i) sum += double(row[i])*row[i];
+    }
+    return float(sum/(double(size)*channels_))*(stft_s16_inv*stft_s16_inv);
+}
@@ -0,0 +1,77 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_STFT_HPP
+#define ZAPPLAYER_STFT_HPP
+
+/*
+ * The short-time Fourier transform front end.  Interleaved blocks are split into a circular history per channel and
+ * a frame of fft_size samples becomes ready every hop_size sample frames, independent of the block length delivered
+ * by the device.  Frames may be extracted per channel or as the mono mix of all channels.
+ * Usage:
+ *
+ *     while(offset != len) {
+ *         offset += stft.push(samples + offset, len - offset);
+ *         if(stft.frame_ready()) { stft.extract(frame, window); stft.next_hop(); ... }
+ *     }
+ */
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+class stft {
+public:
+    // Pass as the channel to extract the average of all channels
+    constexpr static size_t mix_channels = size_t(-1);
+
+    stft(size_t fft_size, size_t hop_size, size_t channels=2);
+
+    size_t fft_size() const { return fft_size_; }
+    size_t hop_size() const { return hop_size_; }
+    size_t channels() const { return channels_; }
+
+    // Consumes interleaved samples up to the end of the next hop, returns the number of samples consumed.  Blocks
+    // need not contain whole sample frames.
+    size_t push(const short* samples, size_t len);
+
+    bool frame_ready() const { return pending_ == 0; }
+
+    // Writes the most recent fft_size samples of channel (oldest first) as floats in [-1, 1] multiplied by window,
+    // which must hold fft_size values
+    void extract(float* output, const float* window, size_t channel=mix_channels) const {
+        extract(output, window, fft_size_, 0, channel);
+    }
+
+    // As above for size samples ending delay samples before the newest, size + delay may not exceed fft_size.  The
+    // delay centres shorter frames on longer ones.  Concurrent extraction from several threads is safe.
+    void extract(float* output, const float* window, size_t size, size_t delay, size_t channel=mix_channels) const;
+
+    // Copies size samples of channel ending delay samples before the newest without windowing, for the fixed-point
+    // transforms.  The mix is the average of all channels.
+    void extract_s16(short* output, size_t size, size_t delay, size_t channel=mix_channels) const;
+
+    // Mean square of the most recent size sample frames over all channels, full scale is 1
+    float mean_square(size_t size) const;
+
+    // Starts the next hop after a frame has been extracted
+    void next_hop() { pending_ = hop_size_; }
+
+    // Total number of sample frames pushed per channel
+    uint64_t position() const { return position_; }
+
+protected:
+    void push_sample(short sample);
+
+    size_t fft_size_;
+    size_t hop_size_;
+    size_t channels_;
+    size_t stride_;                 // Length of each channel's history, a power of two
+    std::vector<short> history_;    // channels_ rows of stride_ samples
+    std::vector<short*> rows_;
+    size_t mask_;
+    size_t write_;
+    size_t phase_;                  // Channel of the next interleaved sample
+    size_t pending_;                // Samples still required before the next frame is ready
+    uint64_t position_;
+};
+
+#endif //ZAPPLAYER_STFT_HPP
@@ -0,0 +1,44 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_TRIPLE_BUFFER_HPP
+#define ZAPPLAYER_TRIPLE_BUFFER_HPP
+
+/*
+ * A wait-free triple buffer for handing complete values from one producer thread to one consumer thread.  The
+ * producer fills back() and publish()es it, the consumer calls update() to acquire the most recently published value
+ * and reads it through front().  Neither side ever blocks or allocates, unconsumed intermediate values are dropped.
+ */
+
+#include <array>
+#include <atomic>
+
+template <typename T>
+class triple_buffer {
+public:
+    triple_buffer() : middle_(1), back_(0), front_(2) { }
+    explicit triple_buffer(const T& init) : buffers_{{init, init, init}}, middle_(1), back_(0), front_(2) { }
+
+    // Producer side
+    T& back() { return buffers_[back_]; }
+    void publish() {
+        back_ = middle_.exchange(back_ | dirty_bit, std::memory_order_acq_rel) & index_mask;
+    }
+
+    // Consumer side, returns true if a newer value was acquired
+    bool update() {
+        if((middle_.load(std::memory_order_relaxed) & dirty_bit) == 0) return false;
+        front_ = middle_.exchange(front_, std::memory_order_acq_rel) & index_mask;
+        return true;
+    }
+    const T& front() const { return buffers_[front_]; }
+
+protected:
+    constexpr static unsigned dirty_bit = 4;
+    constexpr static unsigned index_mask = 3;
+
+    std::array<T, 3> buffers_;
+    std::atomic<unsigned> middle_;      // Index of the shared buffer, with dirty_bit set when it holds a new value
+    unsigned back_;                     // Owned by the producer
+    unsigned front_;                    // Owned by the consumer
+};
+
+#endif //ZAPPLAYER_TRIPLE_BUFFER_HPP
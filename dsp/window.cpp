@@ -0,0 +1,110 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#include "window.hpp"
+#include "cpu_features.hpp"
+#include <map>
+#include <cmath>
+#include <mutex>
+
+#if defined(ZAPPLAYER_SSE2)
+#include <emmintrin.h>
+#endif
+
+constexpr double window_two_pi = 6.28318530717958647692;
+
+// Generalised cosine window coefficients: w(n) = a0 - a1 cos(x) + a2 cos(2x) - a3 cos(3x) + a4 cos(4x)
+static const double* cosine_terms(window_type type) {
+    static const double rectangular[5] = { 1., 0., 0., 0., 0. };
+    static const double hann[5] = { .5, .5, 0., 0., 0. };
+    static const double hamming[5] = { .54, .46, 0., 0., 0. };
+    static const double blackman_harris[5] = { .35875, .48829, .14128, .01168, 0. };
+    static const double flat_top[5] = { .21557895, .41663158, .277263158, .083578947, .006947368 };
+
+    switch(type) {
+        case window_type::WT_RECTANGULAR: return rectangular;
+        case window_type::WT_HANN: return hann;
+        case window_type::WT_HAMMING: return hamming;
+        case window_type::WT_BLACKMAN_HARRIS: return blackman_harris;
+        case window_type::WT_FLAT_TOP: return flat_top;
+    }
+    return rectangular;
+}
+
+static std::vector<float> make_window(window_type type, size_t size) {
+    const double* a = cosine_terms(type);
+    std::vector<float> table(size);
+    for(size_t n = 0; n != size; ++n) {
+        const double x = window_two_pi * n / size;
+        table[n] = float(a[0] - a[1]*std::cos(x) + a[2]*std::cos(2*x) - a[3]*std::cos(3*x) + a[4]*std::cos(4*x));
+    }
+    return table;
+}
+
+window_table_ptr get_window(window_type type, size_t size) {
+    static std::mutex cache_mtx;
+    static std::map<std::pair<window_type, size_t>, window_table_ptr> cache;
+
+    std::unique_lock<std::mutex> lock(cache_mtx);
+    auto& entry = cache[std::make_pair(type, size)];
+    if(!entry) entry = std::make_shared<const std::vector<float>>(make_window(type, size));
+    return entry;
+}
+
+float window_coherent_gain(window_type type) {
+    return float(cosine_terms(type)[0]);
+}
+
+const char* window_name(window_type type) {
+    switch(type) {
+        case window_type::WT_RECTANGULAR: return "rectangular";
+        case window_type::WT_HANN: return "hann";
+        case window_type::WT_HAMMING: return "hamming";
+        case window_type::WT_BLACKMAN_HARRIS: return "blackman-harris";
+        case window_type::WT_FLAT_TOP: return "flat-top";
+    }
+    return "unknown";
+}
+
+void apply_window_s16(const short* input, const float* window, float* output, size_t len, float scale) {
+    size_t i = 0;
+#if defined(ZAPPLAYER_SSE2)
+    const __m128 s = _mm_set1_ps(scale);
+    for(; i + 8 <= len; i += 8) {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+        // Sign extend by placing each short in the high half of a 32 bit lane and shifting down
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+        const __m128 w0 = _mm_mul_ps(s, _mm_loadu_ps(window + i));
+        const __m128 w1 = _mm_mul_ps(s, _mm_loadu_ps(window + i + 4));
+        _mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), w0));
+        _mm_storeu_ps(output + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), w1));
+    }
+#endif
+    for(; i != len; ++i) output[i] = scale * window[i] * input[i];
+}
+
+void accumulate_window_s16(const short* input, const float* window, float* output, size_t len, float scale) {
+    size_t i = 0;
+#if defined(ZAPPLAYER_SSE2)
+    const __m128 s = _mm_set1_ps(scale);
+    for(; i + 8 <= len; i += 8) {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+        const __m128 w0 = _mm_mul_ps(s, _mm_loadu_ps(window + i));
+        const __m128 w1 = _mm_mul_ps(s, _mm_loadu_ps(window + i + 4));
+        _mm_storeu_ps(output + i, _mm_add_ps(_mm_loadu_ps(output + i), _mm_mul_ps(_mm_cvtepi32_ps(lo), w0)));
+        _mm_storeu_ps(output + i + 4, _mm_add_ps(_mm_loadu_ps(output + i + 4), _mm_mul_ps(_mm_cvtepi32_ps(hi), w1)));
+    }
+#endif
+    for(; i != len; ++i) output[i] += scale * window[i] * input[i];
+}
+
+void apply_window(const float* input, const float* window, float* output, size_t len) {
+    size_t i = 0;
+#if defined(ZAPPLAYER_SSE2)
+    for(; i + 4 <= len; i += 4) {
+        _mm_storeu_ps(output + i, _mm_mul_ps(_mm_loadu_ps(input + i), _mm_loadu_ps(window + i)));
+    }
+#endif
+    for(; i != len; ++i) output[i] = input[i] * window[i];
+}
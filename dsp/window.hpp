@@ -0,0 +1,42 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_WINDOW_HPP
+#define ZAPPLAYER_WINDOW_HPP
+
+/*
+ * Window functions for spectral analysis.  Tables are periodic (DFT-even) windows of the requested size, computed
+ * once in double precision and cached for the lifetime of the process.  The apply kernels convert s16 samples to
+ * float, scale and window them in a single pass.
+ */
+
+#include <memory>
+#include <vector>
+#include <cstddef>
+
+enum class window_type {
+    WT_RECTANGULAR,
+    WT_HANN,
+    WT_HAMMING,
+    WT_BLACKMAN_HARRIS,     // 4-term, -92 dB side lobes
+    WT_FLAT_TOP             // Accurate amplitude, wide main lobe
+};
+
+using window_table_ptr = std::shared_ptr<const std::vector<float>>;
+
+// Returns the cached table for type and size, building it on first use.  Thread safe.
+window_table_ptr get_window(window_type type, size_t size);
+
+// Sum of the window divided by its length, the amplitude gain a windowed sinusoid sees
+float window_coherent_gain(window_type type);
+
+const char* window_name(window_type type);
+
+// output[i] = scale * input[i] * window[i]
+void apply_window_s16(const short* input, const float* window, float* output, size_t len, float scale);
+
+// output[i] += scale * input[i] * window[i]
+void accumulate_window_s16(const short* input, const float* window, float* output, size_t len, float scale);
+
+// output[i] = input[i] * window[i]
+void apply_window(const float* input, const float* window, float* output, size_t len);
+
+#endif //ZAPPLAYER_WINDOW_HPP
@@ -0,0 +1,67 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#include "worker_pool.hpp"
+
+worker_pool::worker_pool(size_t threads) : task_(nullptr), count_(0), next_(0), remaining_(0), generation_(0),
+    running_(true) {
+    for(size_t i = 0; i != threads; ++i) workers_.emplace_back(&worker_pool::worker, this);
+}
+
+worker_pool::~worker_pool() {
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        running_ = false;
+    }
+    start_cv_.notify_all();
+    for(auto& w : workers_) w.join();
+}
+
+void worker_pool::run(size_t count, const task_fnc& fnc) {
+    if(count == 0) return;
+    if(workers_.empty() || count == 1) {
+        for(size_t i = 0; i != count; ++i) fnc(i);
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        task_ = &fnc;
+        count_ = count;
+        next_ = 0;
+        remaining_ = count;
+        ++generation_;
+    }
+    start_cv_.notify_all();
+
+    execute();
+
+    std::unique_lock<std::mutex> lock(mtx_);
+    done_cv_.wait(lock, [this]() { return remaining_ == 0; });
+    task_ = nullptr;
+}
+
+void worker_pool::execute() {
+    size_t done = 0;
+    for(size_t i = next_++; i < count_; i = next_++) {
+        (*task_)(i);
+        ++done;
+    }
+
+    if(done != 0) {
+        std::unique_lock<std::mutex> lock(mtx_);
+        remaining_ -= done;
+        if(remaining_ == 0) done_cv_.notify_one();
+    }
+}
+
+void worker_pool::worker() {
+    uint64_t seen = 0;
+    while(true) {
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            start_cv_.wait(lock, [this, seen]() { return !running_ || generation_ != seen; });
+            if(!running_) return;
+            seen = generation_;
+        }
+        execute();
+    }
+}
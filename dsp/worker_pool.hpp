@@ -0,0 +1,46 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_WORKER_POOL_HPP
+#define ZAPPLAYER_WORKER_POOL_HPP
+
+/*
+ * A small fork-join pool.  run() distributes the indices [0, count) over the worker threads and the calling thread
+ * and returns once every index has been processed.  Intended for a handful of coarse tasks per analysis frame, it is
+ * not used from the audio thread.
+ */
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <functional>
+#include <condition_variable>
+
+class worker_pool {
+public:
+    using task_fnc = std::function<void(size_t)>;
+
+    explicit worker_pool(size_t threads);
+    ~worker_pool();
+
+    size_t threads() const { return workers_.size(); }
+
+    void run(size_t count, const task_fnc& fnc);
+
+protected:
+    void worker();
+    void execute();
+
+    std::vector<std::thread> workers_;
+    std::mutex mtx_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    const task_fnc* task_;
+    size_t count_;
+    std::atomic<size_t> next_;
+    size_t remaining_;
+    uint64_t generation_;
+    bool running_;
+};
+
+#endif //ZAPPLAYER_WORKER_POOL_HPP
@@ -0,0 +1,97 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_EQUALISER_STREAM_HPP
+#define ZAPPLAYER_EQUALISER_STREAM_HPP
+
+/*
+ * Applies an equaliser to the playback stream on the calling (audio) thread.  float blocks are filtered in place, s16
+ * blocks are converted to float in chunks of up to max_frames frames, filtered and converted back with saturation, so
+ * nothing is allocated after construction.
+ *
+ * The bands are set from one control thread (the GUI thread) and handed to the audio thread through a triple buffer,
+ * the audio thread picks them up at the start of its next block and ramps to them over that block.  The time spent
+ * filtering every block is published as a smoothed average for display and tuning.
+ */
+
+#include <zapAudio/streams/audio_stream.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include "dsp/equaliser.hpp"
+#include "dsp/sample_ops.hpp"
+#include "dsp/triple_buffer.hpp"
+
+template <typename SampleT>
+class equaliser_stream : public audio_stream<SampleT> {
+public:
+    using stream_t = audio_stream<SampleT>;
+    using buffer_t = typename stream_t::buffer_t;
+    using band_array = std::array<eq_band, equaliser::max_bands>;
+    using clock = std::chrono::steady_clock;
+
+    equaliser_stream(stream_t* input, size_t sample_rate, size_t channels, size_t max_frames=1024,
+                     size_t bands=equaliser::max_bands) : stream_t(input), eq_(float(sample_rate), channels, bands),
+        scratch_(max_frames*channels), block_time_(0.f) {
+        bands_.fill(eq_band{ eq_filter::EF_OFF, 1000.f, 0.f, .707f });
+        settings_.back() = bands_;
+        settings_.publish();
+    }
+
+    size_t bands() const { return eq_.stages(); }
+    size_t latency() const { return eq_.latency(); }
+
+    // Control thread only, idx must be less than bands()
+    void set_band(size_t idx, const eq_band& band) {
+        if(idx >= bands()) return;
+        bands_[idx] = band;
+        settings_.back() = bands_;
+        settings_.publish();
+    }
+    const eq_band& get_band(size_t idx) const { return bands_[idx]; }
+
+    // The mean time in microseconds spent filtering a block, smoothed over roughly the last 20 blocks
+    float block_time() const { return block_time_.load(std::memory_order_relaxed); }
+
+    virtual size_t read(buffer_t& buffer, size_t len) {
+        if(!this->parent()) return 0;
+
+        auto ret = this->parent()->read(buffer, len);
+        const auto start = clock::now();
+        if(settings_.update()) eq_.set_bands(settings_.front().data(), settings_.front().size());
+        filter(buffer.data(), ret/eq_.channels());
+
+        const float elapsed = std::chrono::duration<float, std::micro>(clock::now() - start).count();
+        const float average = block_time_.load(std::memory_order_relaxed);
+        block_time_.store(average + .05f*(elapsed - average), std::memory_order_relaxed);
+        return ret;
+    }
+
+    virtual size_t write(const buffer_t& buffer, size_t len) {
+        return 0;
+    }
+
+protected:
+    void filter(float* samples, size_t frames) {
+        eq_.process(samples, frames);
+    }
+
+    void filter(short* samples, size_t frames) {
+        const size_t channels = eq_.channels(), chunk = scratch_.size()/channels;
+        for(size_t i = 0; i < frames; i += chunk) {
+            const size_t count = std::min(chunk, frames - i);
+            short* block = samples + i*channels;
+            s16_to_float(block, scratch_.data(), count*channels, 1.f);
+            eq_.process(scratch_.data(), count);
+            float_to_s16(scratch_.data(), block, count*channels, 1.f);
+        }
+    }
+
+    equaliser eq_;
+    std::vector<float> scratch_;                // s16 only
+    band_array bands_;                          // The control thread's copy of the bands
+    triple_buffer<band_array> settings_;
+    std::atomic<float> block_time_;
+};
+
+#endif //ZAPPLAYER_EQUALISER_STREAM_HPP
@@ -0,0 +1,114 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#include "feature_file.hpp"
+#include <cstdio>
+#include <memory>
+#include <cmath>
+#include <algorithm>
+
+static const char feature_magic[4] = { 'Z', 'A', 'P', 'F' };
+constexpr static size_t feature_header_words = 6;
+constexpr static size_t feature_header_values = 6;
+constexpr static size_t feature_header_size = 4 + 4*(feature_header_words + feature_header_values);
+
+using file_ptr = std::unique_ptr<FILE, int(*)(FILE*)>;
+
+template <typename T>
+static bool write_values(FILE* fp, const T* values, size_t count) {
+    return count == 0 || fwrite(values, sizeof(T), count, fp) == count;
+}
+
+template <typename T>
+static bool read_values(FILE* fp, T* values, size_t count) {
+    return count == 0 || fread(values, sizeof(T), count, fp) == count;
+}
+
+bool write_features(const std::string& path, const track_features& features) {
+    file_ptr fp(fopen(path.c_str(), "wb"), &fclose);
+    if(!fp) return false;
+
+    const uint32_t frames = uint32_t(features.frames());
+    const bool side = !features.side_bins.empty();
+    const uint32_t header[feature_header_words] = { track_features::version, features.sample_rate,
+                                                    features.hop_size, features.bands, frames,
+                                                    side ? uint32_t(FF_SIDE_BINS) : 0 };
+    const float values[feature_header_values] = { features.min_db, features.max_db, features.loudness,
+                                                  features.true_peak, features.bpm, features.beat_confidence };
+
+    return write_values(fp.get(), feature_magic, 4) && write_values(fp.get(), header, feature_header_words) &&
+           write_values(fp.get(), values, feature_header_values) &&
+           write_values(fp.get(), features.centres.data(), features.bands) &&
+           write_values(fp.get(), features.energy.data(), features.bands) &&
+           write_values(fp.get(), features.level.data(), frames) &&
+           write_values(fp.get(), features.width.data(), frames) &&
+           write_values(fp.get(), features.bins.data(), size_t(frames)*features.bands) &&
+           (!side || write_values(fp.get(), features.side_bins.data(), size_t(frames)*features.bands));
+}
+
+bool read_features(const std::string& path, track_features& features) {
+    file_ptr fp(fopen(path.c_str(), "rb"), &fclose);
+    if(!fp) return false;
+
+    char magic[4];
+    uint32_t header[feature_header_words];
+    float values[feature_header_values];
+    if(!read_values(fp.get(), magic, 4) || !std::equal(magic, magic + 4, feature_magic)) return false;
+    if(!read_values(fp.get(), header, feature_header_words) || header[0] != track_features::version) return false;
+    if(!read_values(fp.get(), values, feature_header_values)) return false;
+
+    features.sample_rate = header[1];
+    features.hop_size = header[2];
+    features.bands = header[3];
+    const uint32_t frames = header[4];
+    features.min_db = values[0];
+    features.max_db = values[1];
+    features.loudness = values[2];
+    features.true_peak = values[3];
+    features.bpm = values[4];
+    features.beat_confidence = values[5];
+
+    features.centres.resize(features.bands);
+    features.energy.resize(features.bands);
+    features.level.resize(frames);
+    features.width.resize(frames);
+    features.bins.resize(size_t(frames)*features.bands);
+    features.side_bins.resize((header[5] & FF_SIDE_BINS) ? features.bins.size() : 0);
+    return read_values(fp.get(), features.centres.data(), features.bands) &&
+           read_values(fp.get(), features.energy.data(), features.bands) &&
+           read_values(fp.get(), features.level.data(), frames) &&
+           read_values(fp.get(), features.width.data(), frames) &&
+           read_values(fp.get(), features.bins.data(), features.bins.size()) &&
+           read_values(fp.get(), features.side_bins.data(), features.side_bins.size());
+}
+
+void track_features::add_frame(const float* frame_bins, const float* frame_side_bins, float frame_level,
+                               float frame_width) {
+    auto quantise = [](float v) { return uint8_t(std::lround(std::min(std::max(v, 0.f), 1.f)*255.f)); };
+    for(size_t b = 0; b != bands; ++b) bins.push_back(quantise(frame_bins[b]));
+    if(frame_side_bins) {
+        for(size_t b = 0; b != bands; ++b) side_bins.push_back(quantise(frame_side_bins[b]));
+    }
+    level.push_back(frame_level);
+    width.push_back(frame_width);
+}
+
+bool feature_map::open(const std::string& path) {
+    if(!file_.open(path) || file_.size() < feature_header_size) return false;
+
+    const uint8_t* ptr = file_.data();
+    if(!std::equal(ptr, ptr + 4, reinterpret_cast<const uint8_t*>(feature_magic))) return false;
+    header_ = reinterpret_cast<const uint32_t*>(ptr + 4);
+    values_ = reinterpret_cast<const float*>(ptr + 4 + 4*feature_header_words);
+    if(header_[0] != track_features::version) return false;
+
+    const size_t bands = header_[3], frames = header_[4];
+    const size_t bin_bytes = frames*bands*(has_side_bins() ? 2 : 1);
+    if(file_.size() != feature_header_size + 4*(2*bands + 2*frames) + bin_bytes) return false;
+
+    centres_ = reinterpret_cast<const float*>(ptr + feature_header_size);
+    energy_ = centres_ + bands;
+    level_ = energy_ + bands;
+    width_ = level_ + frames;
+    bins_ = reinterpret_cast<const uint8_t*>(width_ + frames);
+    side_bins_ = has_side_bins() ? bins_ + frames*bands : nullptr;
+    return true;
+}
@@ -0,0 +1,99 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_FEATURE_FILE_HPP
+#define ZAPPLAYER_FEATURE_FILE_HPP
+
+/*
+ * The per-track feature file written by zapAnalyse and the spectrogram cache.  All fields are little-endian, fixed
+ * size and naturally aligned so a file can be used in place through a memory mapping (feature_map):
+ *
+ *     char magic[4]            "ZAPF"
+ *     uint32 version
+ *     uint32 sample_rate, hop_size, bands, frames
+ *     uint32 flags             FF_SIDE_BINS if side_bins are present
+ *     float min_db, max_db     The dB range the quantised bins map onto
+ *     float loudness           Integrated loudness of the track in LUFS (EBU R128)
+ *     float true_peak          The highest true peak of the track in dBTP
+ *     float bpm, beat_confidence  The medians of the beat tracker's estimates over the track
+ *     float centres[bands]     Band centre frequencies in Hz
+ *     float energy[bands]      Mean power per band over the track in dB
+ *     float level[frames]      RMS level of the hop completing each frame in dBFS
+ *     float width[frames]      Stereo width of each frame
+ *     uint8 bins[frames*bands] Normalised bins quantised to [0, 255], frame major
+ *     uint8 side_bins[frames*bands]
+ */
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "mapped_file.hpp"
+
+enum feature_flags : uint32_t {
+    FF_SIDE_BINS = 1
+};
+
+struct track_features {
+    constexpr static uint32_t version = 3;
+
+    uint32_t sample_rate = 0;
+    uint32_t hop_size = 0;
+    uint32_t bands = 0;
+    float min_db = 0.f;
+    float max_db = 0.f;
+    float loudness = 0.f;
+    float true_peak = 0.f;
+    float bpm = 0.f;
+    float beat_confidence = 0.f;
+    std::vector<float> centres;
+    std::vector<float> energy;
+    std::vector<float> level;
+    std::vector<float> width;
+    std::vector<uint8_t> bins;
+    std::vector<uint8_t> side_bins;         // Empty or the same size as bins
+
+    size_t frames() const { return level.size(); }
+    const uint8_t* frame(size_t idx) const { return bins.data() + idx*bands; }
+
+    // Appends a frame of normalised bins, side_bins may be null
+    void add_frame(const float* frame_bins, const float* frame_side_bins, float frame_level, float frame_width);
+};
+
+bool write_features(const std::string& path, const track_features& features);
+bool read_features(const std::string& path, track_features& features);
+
+// A read-only view of a feature file in place, nothing is copied out of the mapping
+class feature_map {
+public:
+    bool open(const std::string& path);
+
+    uint32_t sample_rate() const { return header_[1]; }
+    uint32_t hop_size() const { return header_[2]; }
+    uint32_t bands() const { return header_[3]; }
+    size_t frames() const { return header_[4]; }
+    bool has_side_bins() const { return (header_[5] & FF_SIDE_BINS) != 0; }
+    float min_db() const { return values_[0]; }
+    float max_db() const { return values_[1]; }
+    float loudness() const { return values_[2]; }
+    float true_peak() const { return values_[3]; }
+    float bpm() const { return values_[4]; }
+    float beat_confidence() const { return values_[5]; }
+
+    const float* centres() const { return centres_; }
+    const float* energy() const { return energy_; }
+    float level(size_t idx) const { return level_[idx]; }
+    float width(size_t idx) const { return width_[idx]; }
+    const uint8_t* bins(size_t idx) const { return bins_ + idx*bands(); }
+    const uint8_t* side_bins(size_t idx) const { return side_bins_ + idx*bands(); }
+
+protected:
+    mapped_file file_;
+    const uint32_t* header_ = nullptr;
+    const float* values_ = nullptr;
+    const float* centres_ = nullptr;
+    const float* energy_ = nullptr;
+    const float* level_ = nullptr;
+    const float* width_ = nullptr;
+    const uint8_t* bins_ = nullptr;
+    const uint8_t* side_bins_ = nullptr;
+};
+
+#endif //ZAPPLAYER_FEATURE_FILE_HPP
@@ -0,0 +1,90 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_FLOAT_STREAM_HPP
+#define ZAPPLAYER_FLOAT_STREAM_HPP
+
+/*
+ * The two ends of the float pipeline.  float_stream converts a decoder's s16 samples to float at full scale 1 once,
+ * right at the source (a resampler_stream does so instead for sources at another rate).  The crossfades, buffering
+ * and every stage after process float so gains and filters neither round nor clip between them.  dither_stream is the
+ * last stage before audio_output and the only requantisation, it converts to s16 with TPDF dither and saturates
+ * anything the float stages pushed beyond full scale.  The analyser observes an s16 copy through an analyser_tap.
+ *
+ * Both work in chunks of up to max_frames frames through scratch buffers allocated at construction.  Their sources are
+ * of the other sample type so they are held alongside rather than as the audio_stream parent.
+ */
+
+#include <zapAudio/streams/audio_stream.hpp>
+#include <vector>
+#include <algorithm>
+#include "dsp/sample_ops.hpp"
+
+class float_stream : public audio_stream<float> {
+public:
+    using stream_t = audio_stream<float>;
+    using buffer_t = typename stream_t::buffer_t;
+    using source_t = audio_stream<short>;
+
+    float_stream(source_t* source, size_t channels, size_t max_frames=1024) : stream_t(nullptr), source_(source),
+        scratch_(max_frames*channels) {
+    }
+
+    source_t* source() const { return source_; }
+
+    virtual size_t read(buffer_t& buffer, size_t len) {
+        if(!source_) return 0;
+
+        size_t ret = 0;
+        while(ret < len) {
+            const size_t count = source_->read(scratch_, std::min(len - ret, scratch_.size()));
+            s16_to_float(scratch_.data(), buffer.data() + ret, count, 1.f/32768.f);
+            ret += count;
+            if(count == 0) break;
+        }
+        return ret;
+    }
+
+    virtual size_t write(const buffer_t& buffer, size_t len) {
+        return 0;
+    }
+
+protected:
+    source_t* source_;
+    std::vector<short> scratch_;
+};
+
+class dither_stream : public audio_stream<short> {
+public:
+    using stream_t = audio_stream<short>;
+    using buffer_t = typename stream_t::buffer_t;
+    using source_t = audio_stream<float>;
+
+    dither_stream(source_t* source, size_t channels, size_t max_frames=1024) : stream_t(nullptr), source_(source),
+        scratch_(max_frames*channels), state_{ 0x9E3779B9u, 0x7F4A7C15u, 0x85EBCA6Bu, 0xC2B2AE35u } {
+    }
+
+    source_t* source() const { return source_; }
+
+    virtual size_t read(buffer_t& buffer, size_t len) {
+        if(!source_) return 0;
+
+        size_t ret = 0;
+        while(ret < len) {
+            const size_t count = source_->read(scratch_, std::min(len - ret, scratch_.size()));
+            float_to_s16_dither(scratch_.data(), buffer.data() + ret, count, 32768.f, state_);
+            ret += count;
+            if(count == 0) break;
+        }
+        return ret;
+    }
+
+    virtual size_t write(const buffer_t& buffer, size_t len) {
+        return 0;
+    }
+
+protected:
+    source_t* source_;
+    std::vector<float> scratch_;
+    uint32_t state_[4];
+};
+
+#endif //ZAPPLAYER_FLOAT_STREAM_HPP
@@ -0,0 +1,80 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#include "library_scan.hpp"
+#include <cctype>
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+static bool has_extension(const std::string& path, const std::string& extension) {
+    if(path.size() <= extension.size() || path[path.size() - extension.size() - 1] != '.') return false;
+    return std::equal(extension.begin(), extension.end(), path.end() - extension.size(), [](char a, char b) {
+        return std::tolower((unsigned char)a) == std::tolower((unsigned char)b);
+    });
+}
+
+#if defined(_WIN32)
+static void scan_directory(const std::string& path, const std::string& extension, std::vector<std::string>& files) {
+    WIN32_FIND_DATAA data;
+    HANDLE handle = FindFirstFileA((path + "\\*").c_str(), &data);
+    if(handle == INVALID_HANDLE_VALUE) return;
+
+    do {
+        const std::string name = data.cFileName;
+        if(name == "." || name == "..") continue;
+        const std::string child = path + "\\" + name;
+        if(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) scan_directory(child, extension, files);
+        else if(has_extension(name, extension))             files.push_back(child);
+    } while(FindNextFileA(handle, &data));
+
+    FindClose(handle);
+}
+
+static bool is_directory(const std::string& path) {
+    const DWORD attributes = GetFileAttributesA(path.c_str());
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+}
+#else
+static bool is_directory(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+static void scan_directory(const std::string& path, const std::string& extension, std::vector<std::string>& files) {
+    DIR* dir = opendir(path.c_str());
+    if(!dir) return;
+
+    while(auto entry = readdir(dir)) {
+        const std::string name = entry->d_name;
+        if(name == "." || name == "..") continue;
+        const std::string child = path + "/" + name;
+        // d_type is not filled in on every file system, fall back to stat
+        const bool directory = entry->d_type == DT_DIR || (entry->d_type == DT_UNKNOWN && is_directory(child));
+        if(directory)                             scan_directory(child, extension, files);
+        else if(has_extension(name, extension))   files.push_back(child);
+    }
+
+    closedir(dir);
+}
+#endif
+
+std::vector<std::string> find_files(const std::string& root, const std::string& extension) {
+    std::vector<std::string> files;
+    if(!is_directory(root)) {
+        if(has_extension(root, extension)) files.push_back(root);
+        return files;
+    }
+
+    scan_directory(root, extension, files);
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+std::string file_name(const std::string& path) {
+    const auto pos = path.find_last_of("/\\");
+    return pos == std::string::npos ? path : path.substr(pos + 1);
+}
@@ -0,0 +1,15 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_LIBRARY_SCAN_HPP
+#define ZAPPLAYER_LIBRARY_SCAN_HPP
+
+#include <string>
+#include <vector>
+
+// Recursively collects the files under root whose extension matches extension (without the dot, case insensitive),
+// sorted by path.  A root that is itself a matching file is returned alone.
+std::vector<std::string> find_files(const std::string& root, const std::string& extension);
+
+// The final component of path
+std::string file_name(const std::string& path);
+
+#endif //ZAPPLAYER_LIBRARY_SCAN_HPP
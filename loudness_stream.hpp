@@ -0,0 +1,72 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_LOUDNESS_STREAM_HPP
+#define ZAPPLAYER_LOUDNESS_STREAM_HPP
+
+/*
+ * Passes the playback stream through unchanged while measuring its loudness with a loudness_meter on the calling
+ * (audio) thread.  The readings are published as atomics after every block so any number of threads may poll them
+ * without locking, a reading may mix values from two consecutive blocks.  Place the stage before the volume control
+ * to measure the programme rather than the listening level.  float samples are measured at full scale 1.
+ */
+
+#include <zapAudio/streams/audio_stream.hpp>
+#include <atomic>
+#include "dsp/loudness_meter.hpp"
+
+template <typename SampleT>
+class loudness_stream : public audio_stream<SampleT> {
+public:
+    using stream_t = audio_stream<SampleT>;
+    using buffer_t = typename stream_t::buffer_t;
+
+    loudness_stream(stream_t* input, size_t sample_rate, size_t channels) : stream_t(input),
+        meter_(float(sample_rate), channels), reset_(false) {
+        publish();
+    }
+
+    // Restarts the integrated loudness and peak, applied by the audio thread before its next block
+    void reset() { reset_.store(true, std::memory_order_release); }
+
+    loudness_state state() const {
+        return { momentary_.load(std::memory_order_relaxed), short_term_.load(std::memory_order_relaxed),
+                 integrated_.load(std::memory_order_relaxed), true_peak_.load(std::memory_order_relaxed),
+                 block_peak_.load(std::memory_order_relaxed) };
+    }
+
+    float momentary() const { return momentary_.load(std::memory_order_relaxed); }
+    float short_term() const { return short_term_.load(std::memory_order_relaxed); }
+    float integrated() const { return integrated_.load(std::memory_order_relaxed); }
+
+    virtual size_t read(buffer_t& buffer, size_t len) {
+        if(!this->parent()) return 0;
+
+        auto ret = this->parent()->read(buffer, len);
+        if(reset_.exchange(false, std::memory_order_acquire)) meter_.reset();
+        meter_.process(buffer.data(), ret/meter_.channels());
+        publish();
+        return ret;
+    }
+
+    virtual size_t write(const buffer_t& buffer, size_t len) {
+        return 0;
+    }
+
+protected:
+    void publish() {
+        momentary_.store(meter_.momentary(), std::memory_order_relaxed);
+        short_term_.store(meter_.short_term(), std::memory_order_relaxed);
+        integrated_.store(meter_.integrated(), std::memory_order_relaxed);
+        true_peak_.store(meter_.true_peak(), std::memory_order_relaxed);
+        block_peak_.store(meter_.block_peak(), std::memory_order_relaxed);
+    }
+
+    loudness_meter meter_;
+    std::atomic<bool> reset_;
+    std::atomic<float> momentary_;
+    std::atomic<float> short_term_;
+    std::atomic<float> integrated_;
+    std::atomic<float> true_peak_;
+    std::atomic<float> block_peak_;
+};
+
+#endif //ZAPPLAYER_LOUDNESS_STREAM_HPP
@@ -0,0 +1,40 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_MAPPED_FILE_HPP
+#define ZAPPLAYER_MAPPED_FILE_HPP
+
+/*
+ * A read-only memory mapping of a whole file (mmap on POSIX, MapViewOfFile on Windows).  Pages are loaded on demand
+ * and shared with the page cache so mapping a large file costs nothing until it is read.
+ */
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+class mapped_file {
+public:
+    mapped_file() = default;
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+    ~mapped_file() { close(); }
+
+    bool open(const std::string& path);
+    void close();
+
+    bool is_open() const { return data_ != nullptr; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+protected:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+#if defined(_WIN32)
+    void* file_ = nullptr;
+    void* mapping_ = nullptr;
+#endif
+};
+
+// 64 bit FNV-1a hash of len bytes, continuing from hash
+uint64_t fnv1a_64(const void* data, size_t len, uint64_t hash=14695981039346656037ULL);
+
+#endif //ZAPPLAYER_MAPPED_FILE_HPP
@@ -0,0 +1,62 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#include "mp3_probe.hpp"
+#include "mapped_file.hpp"
+#include <cstring>
+
+// kbit/s by the bitrate index, index 0 is free format and 15 invalid
+static const size_t mpeg1_bitrates[15] = { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 };
+static const size_t mpeg2_bitrates[15] = { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 };
+static const size_t mpeg1_rates[3] = { 44100, 48000, 32000 };
+
+struct frame_header {
+    size_t version;                 // 3 MPEG 1, 2 MPEG 2, 0 MPEG 2.5
+    size_t sample_rate;
+    size_t channels;
+    size_t length;                  // Bytes including the header
+};
+
+static bool parse_header(const uint8_t* ptr, frame_header& header) {
+    if(ptr[0] != 0xFF || (ptr[1] & 0xE0) != 0xE0) return false;
+
+    const size_t version = (ptr[1] >> 3) & 3, layer = (ptr[1] >> 1) & 3;
+    const size_t bitrate_index = ptr[2] >> 4, rate_index = (ptr[2] >> 2) & 3, padding = (ptr[2] >> 1) & 1;
+    if(version == 1 || layer != 1 || bitrate_index == 0 || bitrate_index == 15 || rate_index == 3) return false;
+
+    header.version = version;
+    header.sample_rate = mpeg1_rates[rate_index] >> (version == 3 ? 0 : version == 2 ? 1 : 2);
+    header.channels = (ptr[3] >> 6) == 3 ? 1 : 2;
+    // MPEG 2 and 2.5 frames hold half the samples of MPEG 1
+    const size_t bitrate = 1000*(version == 3 ? mpeg1_bitrates : mpeg2_bitrates)[bitrate_index];
+    header.length = (version == 3 ? 144 : 72)*bitrate/header.sample_rate + padding;
+    return true;
+}
+
+bool probe_mp3(const std::string& path, mp3_format& format) {
+    mapped_file file;
+    if(!file.open(path)) return false;
+
+    const uint8_t* data = file.data();
+    const size_t size = file.size();
+    size_t offset = 0;
+
+    // ID3v2: a 10 byte header with the tag size in 7 bit bytes, then the tag and an optional 10 byte footer
+    if(size >= 10 && std::memcmp(data, "ID3", 3) == 0) {
+        offset = 10 + (size_t(data[6] & 0x7F) << 21 | size_t(data[7] & 0x7F) << 14 |
+                       size_t(data[8] & 0x7F) << 7 | size_t(data[9] & 0x7F));
+        if(data[5] & 0x10) offset += 10;
+    }
+
+    for(frame_header header, next; offset + 4 <= size; ++offset) {
+        if(!parse_header(data + offset, header)) continue;
+
+        const size_t following = offset + header.length;
+        if(following + 4 <= size && (!parse_header(data + following, next) || next.version != header.version ||
+                                     next.sample_rate != header.sample_rate)) continue;
+        if(following > size) continue;
+
+        format.sample_rate = header.sample_rate;
+        format.channels = header.channels;
+        return true;
+    }
+    return false;
+}
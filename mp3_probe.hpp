@@ -0,0 +1,23 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_MP3_PROBE_HPP
+#define ZAPPLAYER_MP3_PROBE_HPP
+
+/*
+ * Reads the format of an MP3 from its first MPEG audio frame header without decoding, so the player can set up the
+ * chain and zapAnalyse the analyser for the source's sample rate before mp3_stream starts.  An ID3v2 tag is skipped
+ * and a header is only accepted if the frame it describes is followed by another with the same format (or the end of
+ * the file), which rejects sync words that happen to occur in tag or image data.
+ */
+
+#include <string>
+#include <cstddef>
+
+struct mp3_format {
+    size_t sample_rate = 0;
+    size_t channels = 0;
+};
+
+// Layer III (MPEG 1, 2 and 2.5) only
+bool probe_mp3(const std::string& path, mp3_format& format);
+
+#endif //ZAPPLAYER_MP3_PROBE_HPP
@@ -0,0 +1,85 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_RESAMPLER_STREAM_HPP
+#define ZAPPLAYER_RESAMPLER_STREAM_HPP
+
+/*
+ * Converts a decoder's sample rate to the device's and starts the float pipeline in place of a float_stream: the s16
+ * samples are converted to float at full scale 1 once and the resampled output stays float, so it is only quantised
+ * by the dither_stream at the end of the chain.  Blocks of up to max_frames frames are read from the source and
+ * resampled, the output the caller did not take is kept for its next read so every read returns len samples until
+ * the source ends.  At the end of the source the frames the filter holds back are flushed with silence.  Nothing is
+ * allocated after construction.
+ *
+ * The source is of the other sample type so it is held alongside rather than as the audio_stream parent.
+ */
+
+#include <zapAudio/streams/audio_stream.hpp>
+#include <vector>
+#include <algorithm>
+#include "dsp/resampler.hpp"
+#include "dsp/sample_ops.hpp"
+
+class resampler_stream : public audio_stream<float> {
+public:
+    using stream_t = audio_stream<float>;
+    using buffer_t = typename stream_t::buffer_t;
+    using source_t = audio_stream<short>;
+
+    resampler_stream(source_t* source, size_t input_rate, size_t output_rate, size_t channels, size_t max_frames=1024)
+        : stream_t(nullptr), source_(source), resampler_(input_rate, output_rate, channels, max_frames),
+        input_(max_frames*channels), dry_(max_frames*channels), pending_(resampler_.max_output(max_frames)*channels),
+        head_(0), tail_(0), flushed_(false) {
+    }
+
+    source_t* source() const { return source_; }
+    size_t input_rate() const { return resampler_.input_rate(); }
+    size_t output_rate() const { return resampler_.output_rate(); }
+
+    virtual size_t read(buffer_t& buffer, size_t len) {
+        if(!source_) return 0;
+
+        size_t ret = 0;
+        while(ret < len) {
+            if(head_ == tail_ && !refill()) break;
+            const size_t count = std::min(len - ret, tail_ - head_);
+            std::copy(pending_.begin() + head_, pending_.begin() + head_ + count, buffer.begin() + ret);
+            head_ += count;
+            ret += count;
+        }
+        return ret;
+    }
+
+    virtual size_t write(const buffer_t& buffer, size_t len) {
+        return 0;
+    }
+
+protected:
+    // Resamples the next block of the source into pending_, false once the source and the filter are exhausted
+    bool refill() {
+        const size_t channels = resampler_.channels();
+        size_t samples = source_->read(input_, input_.size());
+        if(samples == 0) {
+            if(flushed_) return false;
+            samples = std::min(resampler_.taps()*channels, input_.size());
+            std::fill(input_.begin(), input_.begin() + samples, short(0));
+            flushed_ = true;
+        }
+
+        s16_to_float(input_.data(), dry_.data(), samples, 1.f/32768.f);
+        const size_t frames = resampler_.process(dry_.data(), samples/channels, pending_.data());
+        head_ = 0;
+        tail_ = frames*channels;
+        return true;
+    }
+
+    source_t* source_;
+    resampler resampler_;
+    std::vector<short> input_;
+    std::vector<float> dry_;
+    buffer_t pending_;                  // Resampled output from head_ to tail_ not yet read
+    size_t head_;
+    size_t tail_;
+    bool flushed_;
+};
+
+#endif //ZAPPLAYER_RESAMPLER_STREAM_HPP
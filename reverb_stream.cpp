@@ -0,0 +1,200 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#include <cmath>
+#include <algorithm>
+#include <zap/maths/maths.hpp>
+#include "reverb_stream.hpp"
+#include "wav_file.hpp"
+#include "dsp/sample_ops.hpp"
+
+#define LOGGING_ENABLED
+#include <zap/tools/log.hpp>
+
+// A fresh response is heard at a quarter of the level until set_mix() is called
+constexpr static float default_mix = .25f;
+
+template <typename SampleT>
+reverb_stream<SampleT>::reverb_stream(stream_t* input, size_t sample_rate, size_t channels, size_t block_size) :
+    stream_t(input), sample_rate_(sample_rate), channels_(channels), block_size_(block_size), pending_(nullptr),
+    retired_(nullptr), active_(nullptr), mix_(default_mix), applied_mix_(default_mix),
+    dry_(block_size*channels), wet_(block_size*channels), input_(block_size*channels), output_(block_size*channels),
+    input_frames_(0), output_head_(0), output_frames_(0) {
+}
+
+template <typename SampleT>
+reverb_stream<SampleT>::~reverb_stream() {
+    delete pending_.load();
+    delete retired_.load();
+    delete active_;
+}
+
+template <typename SampleT>
+void reverb_stream<SampleT>::release_retired() {
+    delete retired_.exchange(nullptr, std::memory_order_acquire);
+}
+
+template <typename SampleT>
+bool reverb_stream<SampleT>::load_impulse(const std::string& path) {
+    release_retired();
+
+    wav_data wav;
+    if(!read_wav(path, wav) || wav.frames() == 0) {
+        LOG_ERR("Failed to read the impulse response " + path);
+        return false;
+    }
+    if(wav.sample_rate != sample_rate_) {
+        LOG_ERR("The impulse response " + path + " is at " + std::to_string(wav.sample_rate) + " Hz, the stream at " +
+                std::to_string(sample_rate_) + " Hz");
+        return false;
+    }
+
+    std::vector<double> energy(wav.channels, 0.);
+    for(size_t i = 0; i != wav.samples.size(); ++i) energy[i % wav.channels] += double(wav.samples[i])*wav.samples[i];
+    const double peak_energy = *std::max_element(energy.begin(), energy.end());
+    if(peak_energy <= 0.) {
+        LOG_ERR("The impulse response " + path + " is silent");
+        return false;
+    }
+
+    const float scale = float(1./std::sqrt(peak_energy));
+    for(auto& s : wav.samples) s *= scale;
+
+    auto ptr = new convolver(block_size_, channels_, wav.samples.data(), wav.channels, wav.frames());
+    delete pending_.exchange(ptr, std::memory_order_acq_rel);
+    return true;
+}
+
+template <typename SampleT>
+void reverb_stream<SampleT>::set_mix(float mix) {
+    mix_.store(zap::maths::clamp(mix, 0.f, 1.f), std::memory_order_relaxed);
+    release_retired();
+}
+
+template <typename SampleT>
+size_t reverb_stream<SampleT>::read(buffer_t& buffer, size_t len) {
+    if(!this->parent()) return 0;
+
+    auto ret = this->parent()->read(buffer, len);
+
+    // A new response is only taken once the control thread has freed the last one replaced
+    if(pending_.load(std::memory_order_relaxed) && !retired_.load(std::memory_order_acquire)) {
+        convolver* ptr = pending_.exchange(nullptr, std::memory_order_acq_rel);
+        if(ptr) {
+            retired_.store(active_, std::memory_order_release);
+            active_ = ptr;
+        }
+    }
+    if(!active_) return ret;
+
+    const float mix = mix_.load(std::memory_order_relaxed);
+    if(ret == 0) return flush(buffer.data(), len/channels_, mix)*channels_;
+    process(buffer.data(), ret/channels_, mix);
+    return ret;
+}
+
+template <typename SampleT>
+void reverb_stream<SampleT>::process(short* samples, size_t frames, float mix) {
+    for(size_t i = 0; i < frames; i += block_size_) {
+        const size_t len = std::min(block_size_, frames - i)*channels_;
+        short* block = samples + i*channels_;
+        s16_to_float(block, dry_.data(), len, 1.f);
+        process(dry_.data(), len/channels_, mix);
+        float_to_s16(dry_.data(), block, len, 1.f);
+    }
+}
+
+template <typename SampleT>
+void reverb_stream<SampleT>::process(float* samples, size_t frames, float mix) {
+    size_t i = 0;
+    while(i != frames) {
+        float* chunk = samples + i*channels_;
+        if(input_frames_ == 0 && output_frames_ == 0 && frames - i >= block_size_) {
+            mix_block(chunk, chunk, mix);
+            i += block_size_;
+            continue;
+        }
+
+        // The chunk joins the partition being collected and is replaced by the oldest mixed frames, silence where too
+        // few are left, which lengthens the delay.  The delay never exceeds a partition, so the mixed frames have all
+        // been read by the time the partition completes.
+        const size_t count = std::min(block_size_ - input_frames_, frames - i);
+        std::copy(chunk, chunk + count*channels_, input_.begin() + input_frames_*channels_);
+        input_frames_ += count;
+
+        const size_t ready = std::min(count, output_frames_);
+        const auto head = output_.begin() + output_head_*channels_;
+        std::copy(head, head + ready*channels_, chunk);
+        std::fill(chunk + ready*channels_, chunk + count*channels_, 0.f);
+        output_head_ += ready;
+        output_frames_ -= ready;
+
+        if(input_frames_ == block_size_) {
+            mix_block(input_.data(), output_.data(), mix);
+            input_frames_ = 0;
+            output_head_ = 0;
+            output_frames_ = block_size_;
+        }
+        i += count;
+    }
+}
+
+template <typename SampleT>
+size_t reverb_stream<SampleT>::flush(short* samples, size_t frames, float mix) {
+    size_t ret = 0;
+    while(ret != frames) {
+        const size_t count = flush(dry_.data(), std::min(block_size_, frames - ret), mix);
+        if(count == 0) break;
+        float_to_s16(dry_.data(), samples + ret*channels_, count*channels_, 1.f);
+        ret += count;
+    }
+    return ret;
+}
+
+// Once the source has nothing to read, the mixed frames held back are returned and the partition being collected is
+// completed with silence and returned whole.  Its tail stands in for the frames the source did not deliver, so the
+// output catches up with the convolver and the delay returns to zero.
+template <typename SampleT>
+size_t reverb_stream<SampleT>::flush(float* samples, size_t frames, float mix) {
+    size_t ret = 0;
+    while(ret != frames) {
+        if(output_frames_ == 0) {
+            if(input_frames_ == 0) break;
+            std::fill(input_.begin() + input_frames_*channels_, input_.end(), 0.f);
+            mix_block(input_.data(), output_.data(), mix);
+            input_frames_ = 0;
+            output_head_ = 0;
+            output_frames_ = block_size_;
+        }
+
+        const size_t count = std::min(frames - ret, output_frames_);
+        const auto head = output_.begin() + output_head_*channels_;
+        std::copy(head, head + count*channels_, samples + ret*channels_);
+        output_head_ += count;
+        output_frames_ -= count;
+        ret += count;
+    }
+    return ret;
+}
+
+// Mixes block_size_ frames of input with the reverb into output, which may alias input, ramping from the last mix
+template <typename SampleT>
+void reverb_stream<SampleT>::mix_block(const float* input, float* output, float mix) {
+    active_->process(input, wet_.data());
+
+    const float step = (mix - applied_mix_)/block_size_;
+    for(size_t f = 0; f != block_size_; ++f) {
+        const float m = applied_mix_ + step*f;
+        for(size_t c = 0; c != channels_; ++c) {
+            const size_t i = f*channels_ + c;
+            output[i] = input[i] + m*(wet_[i] - input[i]);
+        }
+    }
+    applied_mix_ = mix;
+}
+
+template <typename SampleT>
+size_t reverb_stream<SampleT>::write(const buffer_t& buffer, size_t len) {
+    return 0;
+}
+
+template class reverb_stream<short>;
+template class reverb_stream<float>;
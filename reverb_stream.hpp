@@ -0,0 +1,74 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_REVERB_STREAM_HPP
+#define ZAPPLAYER_REVERB_STREAM_HPP
+
+/*
+ * A convolution reverb.  The impulse response is read from a WAV file, normalised so that its loudest channel has unit
+ * energy (the wet signal of a noise-like input is as loud as the dry) and convolved on the calling (audio) thread by a
+ * partitioned convolver with partitions of block_size frames.  While every read is a multiple of block_size frames
+ * the partitions are convolved in place without delay.  The frames of a shorter read (a buffer underrun) wait in a
+ * FIFO until their partition is complete, so the convolver only ever sees the input, and from then on the output lags
+ * by up to one partition, the lag entering as silence.  A read that returns nothing flushes the FIFO, completing the
+ * partition with the silence the source delivered, and the lag returns to zero.  float blocks are processed in place,
+ * s16 blocks through a float scratch buffer.
+ *
+ * load_impulse() builds the convolver on the control thread and hands it to the audio thread without locking.  The
+ * replaced convolver, several MB for a long response, is freed by the control thread's next call to release_retired(),
+ * load_impulse() or set_mix(), and no further response is taken until it is.  Call release_retired() periodically,
+ * the player does on every GUI tick.  The wet/dry mix is an atomic ramped over each block.  Until a response is loaded
+ * the stream passes the audio through untouched.
+ */
+
+#include <zapAudio/streams/audio_stream.hpp>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "dsp/convolver.hpp"
+
+template <typename SampleT>
+class reverb_stream : public audio_stream<SampleT> {
+public:
+    using stream_t = audio_stream<SampleT>;
+    using buffer_t = typename stream_t::buffer_t;
+
+    reverb_stream(stream_t* input, size_t sample_rate, size_t channels, size_t block_size=1024);
+    virtual ~reverb_stream();
+
+    // Control thread only.  Fails if the file cannot be read or its sample rate differs from the stream's.
+    bool load_impulse(const std::string& path);
+
+    // 0 is dry and 1 only the reverb
+    void set_mix(float mix);
+    float get_mix() const { return mix_.load(std::memory_order_relaxed); }
+
+    // Control thread only.  Frees the convolver the audio thread last replaced, if any.
+    void release_retired();
+
+    virtual size_t read(buffer_t& buffer, size_t len);
+    virtual size_t write(const buffer_t& buffer, size_t len);
+
+protected:
+    void process(short* samples, size_t frames, float mix);
+    void process(float* samples, size_t frames, float mix);
+    size_t flush(short* samples, size_t frames, float mix);
+    size_t flush(float* samples, size_t frames, float mix);
+    void mix_block(const float* input, float* output, float mix);
+
+    size_t sample_rate_;
+    size_t channels_;
+    size_t block_size_;
+    std::atomic<convolver*> pending_;           // Built by the control thread, not yet taken by the audio thread
+    std::atomic<convolver*> retired_;           // Replaced by the audio thread, to be freed by the control thread
+    convolver* active_;                         // Audio thread only
+    std::atomic<float> mix_;
+    float applied_mix_;                         // The mix reached at the end of the last block, audio thread only
+    std::vector<float> dry_;                    // s16 blocks only
+    std::vector<float> wet_;
+    std::vector<float> input_;                  // The frames of an incomplete partition
+    std::vector<float> output_;                 // Mixed frames not yet read, from output_head_
+    size_t input_frames_;
+    size_t output_head_;
+    size_t output_frames_;
+};
+
+#endif //ZAPPLAYER_REVERB_STREAM_HPP
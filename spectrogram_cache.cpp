@@ -0,0 +1,97 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#include "spectrogram_cache.hpp"
+#include <cstdio>
+
+#define LOGGING_ENABLED
+#include <zap/tools/log.hpp>
+
+template <typename T>
+static uint64_t hash_value(const T& value, uint64_t hash) {
+    return fnv1a_64(&value, sizeof(T), hash);
+}
+
+// Only the settings that change the frames written to the cache, the pitch is not cached
+static uint64_t config_hash(const analyser_config& config) {
+    uint64_t hash = fnv1a_64("ZAPF", 4);
+    hash = hash_value(uint32_t(track_features::version), hash);
+    hash = hash_value(uint64_t(config.sample_rate), hash);
+    hash = hash_value(uint64_t(config.hop_size), hash);
+    hash = hash_value(uint32_t(config.scale), hash);
+    hash = hash_value(uint32_t(config.window), hash);
+    hash = hash_value(uint32_t(config.stereo), hash);
+    hash = hash_value(config.min_db, hash);
+    hash = hash_value(config.max_db, hash);
+    hash = hash_value(config.attack_time, hash);
+    hash = hash_value(config.release_time, hash);
+    hash = hash_value(uint32_t(config.arithmetic), hash);
+    if(config.resolutions.empty()) {
+        hash = hash_value(uint64_t(config.fft_size), hash);
+        hash = hash_value(uint64_t(config.bins), hash);
+        hash = hash_value(config.min_frequency, hash);
+        hash = hash_value(config.max_frequency, hash);
+    } else {
+        for(const auto& res : config.resolutions) {
+            hash = hash_value(uint64_t(res.fft_size), hash);
+            hash = hash_value(uint64_t(res.bins), hash);
+            hash = hash_value(res.min_frequency, hash);
+            hash = hash_value(res.max_frequency, hash);
+        }
+    }
+    return hash;
+}
+
+spectrogram_cache::spectrogram_cache(const std::string& directory, const analyser_config& config)
+    : directory_(directory), config_key_(config_hash(config)) {
+}
+
+spectrogram_cache::feature_map_ptr spectrogram_cache::lookup(const std::string& track, uint64_t& key) const {
+    key = 0;
+    mapped_file file;
+    if(!file.open(track)) {
+        LOG_ERR("Failed to hash " + track);
+        return nullptr;
+    }
+
+    // The track is read through the page cache here and again by the decoder shortly after
+    key = fnv1a_64(file.data(), file.size(), config_key_);
+    if(key == 0) key = 1;       // 0 disables recording in the analyser
+
+    auto map = std::make_shared<feature_map>();
+    if(!map->open(entry_path(key))) return nullptr;
+    return map;
+}
+
+bool spectrogram_cache::store(uint64_t key, const track_features& features) {
+    if(key == 0 || features.frames() == 0) return false;
+
+    std::lock_guard<std::mutex> lock(store_mtx_);
+    const std::string path = entry_path(key);
+    {
+        feature_map existing;
+        if(existing.open(path) && existing.frames() >= features.frames()) return true;
+    }
+
+    // Written aside and renamed so that a concurrent lookup never maps a partial file
+    const std::string temp = path + ".tmp";
+    if(!write_features(temp, features)) {
+        LOG_ERR("Failed to write " + temp);
+        std::remove(temp.c_str());
+        return false;
+    }
+
+#if defined(_WIN32)
+    std::remove(path.c_str());
+#endif
+    if(std::rename(temp.c_str(), path.c_str()) != 0) {
+        LOG_ERR("Failed to store " + path);
+        std::remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::string spectrogram_cache::entry_path(uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.zapf", static_cast<unsigned long long>(key));
+    return directory_ + "/" + name;
+}
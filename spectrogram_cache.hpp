@@ -0,0 +1,38 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_SPECTROGRAM_CACHE_HPP
+#define ZAPPLAYER_SPECTROGRAM_CACHE_HPP
+
+/*
+ * A directory of feature files (see feature_file.hpp) holding the analysed frames of every track played.  Tracks are
+ * keyed by a hash of the mp3 contents combined with a hash of the analyser settings that shape the frames, so a
+ * renamed track still hits and a change of settings misses rather than serving frames of the wrong layout.  Entries
+ * are <directory>/<key>.zapf and are memory mapped on lookup, the analyser reads frames straight from the mapping.
+ */
+
+#include <mutex>
+#include <string>
+#include "analyser_stream.hpp"
+
+class spectrogram_cache {
+public:
+    using feature_map_ptr = analyser_stream::feature_map_ptr;
+
+    spectrogram_cache(const std::string& directory, const analyser_config& config);
+
+    const std::string& directory() const { return directory_; }
+
+    // Hashes track into key and returns the cached frames, null on a miss or if the track cannot be read
+    feature_map_ptr lookup(const std::string& track, uint64_t& key) const;
+
+    // Stores the frames of key unless a longer recording is already cached.  Safe to call from any thread.
+    bool store(uint64_t key, const track_features& features);
+
+protected:
+    std::string entry_path(uint64_t key) const;
+
+    std::string directory_;
+    uint64_t config_key_;
+    std::mutex store_mtx_;
+};
+
+#endif //ZAPPLAYER_SPECTROGRAM_CACHE_HPP
@@ -0,0 +1,77 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#include "wav_file.hpp"
+#include "mapped_file.hpp"
+#include <cstring>
+#include <algorithm>
+
+constexpr static uint16_t wav_format_pcm = 1;
+constexpr static uint16_t wav_format_float = 3;
+constexpr static uint16_t wav_format_extensible = 0xFFFE;
+
+template <typename T>
+static T read_value(const uint8_t* ptr) {
+    T value;
+    std::memcpy(&value, ptr, sizeof(T));
+    return value;
+}
+
+static float read_sample(const uint8_t* ptr, uint16_t format, uint16_t bits) {
+    if(format == wav_format_float) {
+        return bits == 32 ? read_value<float>(ptr) : float(read_value<double>(ptr));
+    }
+
+    switch(bits) {
+        case 8:  return (int(ptr[0]) - 128)/128.f;      // 8 bit PCM is unsigned
+        case 16: return read_value<int16_t>(ptr)/32768.f;
+        case 24: return int32_t(uint32_t(ptr[0]) << 8 | uint32_t(ptr[1]) << 16 | uint32_t(ptr[2]) << 24)/2147483648.f;
+        default: return read_value<int32_t>(ptr)/2147483648.f;
+    }
+}
+
+bool read_wav(const std::string& path, wav_data& wav) {
+    mapped_file file;
+    if(!file.open(path) || file.size() < 12) return false;
+
+    const uint8_t* data = file.data();
+    if(std::memcmp(data, "RIFF", 4) != 0 || std::memcmp(data + 8, "WAVE", 4) != 0) return false;
+
+    uint16_t format = 0, channels = 0, bits = 0, block_align = 0;
+    uint32_t sample_rate = 0;
+    const uint8_t* samples = nullptr;
+    size_t sample_bytes = 0;
+
+    // Chunks are padded to an even size
+    for(size_t offset = 12; offset + 8 <= file.size();) {
+        const uint8_t* chunk = data + offset;
+        const size_t size = std::min<size_t>(read_value<uint32_t>(chunk + 4), file.size() - offset - 8);
+        if(std::memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+            format = read_value<uint16_t>(chunk + 8);
+            channels = read_value<uint16_t>(chunk + 10);
+            sample_rate = read_value<uint32_t>(chunk + 12);
+            block_align = read_value<uint16_t>(chunk + 20);
+            bits = read_value<uint16_t>(chunk + 22);
+            // The sub-format GUID of an extensible file starts with the plain format code
+            if(format == wav_format_extensible && size >= 40) format = read_value<uint16_t>(chunk + 32);
+        } else if(std::memcmp(chunk, "data", 4) == 0) {
+            samples = chunk + 8;
+            sample_bytes = size;
+        }
+        offset += 8 + size + (size & 1);
+    }
+
+    const bool pcm = format == wav_format_pcm && (bits == 8 || bits == 16 || bits == 24 || bits == 32);
+    const bool ieee = format == wav_format_float && (bits == 32 || bits == 64);
+    if(!samples || channels == 0 || sample_rate == 0 || (!pcm && !ieee) || block_align < channels*bits/8) {
+        return false;
+    }
+
+    const size_t frames = sample_bytes/block_align, width = bits/8;
+    wav.sample_rate = sample_rate;
+    wav.channels = channels;
+    wav.samples.resize(frames*channels);
+    for(size_t f = 0; f != frames; ++f) {
+        const uint8_t* frame = samples + f*block_align;
+        for(size_t c = 0; c != channels; ++c) wav.samples[f*channels + c] = read_sample(frame + c*width, format, bits);
+    }
+    return true;
+}
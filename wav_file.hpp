@@ -0,0 +1,25 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+#ifndef ZAPPLAYER_WAV_FILE_HPP
+#define ZAPPLAYER_WAV_FILE_HPP
+
+/*
+ * Reads RIFF WAVE files such as impulse responses.  Integer PCM of 8, 16, 24 and 32 bits and IEEE float of 32 and 64
+ * bits are accepted, plain or as WAVE_FORMAT_EXTENSIBLE, and converted to float in [-1, 1].  Unknown chunks are
+ * skipped.  The file is read through a memory mapping and assumed little-endian like the rest of the formats.
+ */
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+struct wav_data {
+    uint32_t sample_rate = 0;
+    uint32_t channels = 0;
+    std::vector<float> samples;         // Interleaved
+
+    size_t frames() const { return channels != 0 ? samples.size()/channels : 0; }
+};
+
+bool read_wav(const std::string& path, wav_data& wav);
+
+#endif //ZAPPLAYER_WAV_FILE_HPP
@@ -0,0 +1,142 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+
+/*
+ * zapAnalyse, the headless library analyser.  Decodes every mp3 under the given paths through mp3_stream and the
+ * analyser_stream FFT path as fast as the CPU allows, one track per worker, and writes a feature file per track (see
+ * feature_file.hpp).
+ *
+ *     zapAnalyse [-j threads] [-o output_dir] path...
+ *
+ * Without -o the feature file is written next to the track as <track>.zapf.
+ */
+
+#include <mutex>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <zapAudio/streams/mp3_stream.hpp>
+#include "analyser_stream.hpp"
+#include "feature_file.hpp"
+#include "library_scan.hpp"
+#include "mp3_probe.hpp"
+#include "dsp/worker_pool.hpp"
+
+#define LOGGING_ENABLED
+#include <zap/tools/log.hpp>
+
+constexpr static size_t analyse_frame_size = 1024;      // mp3_stream decode frame
+
+struct track_job {
+    std::string path;
+    std::string output;
+};
+
+// Offline analysis favours compact files, a 1024 sample hop gives 43 frames per second of 64 bands at 44.1 kHz.  The
+// track is analysed at its own rate so the bands and the hop duration recorded are the track's.
+static analyser_config make_config(size_t sample_rate) {
+    analyser_config config;
+    config.sample_rate = sample_rate;
+    config.fft_size = 4096;
+    config.hop_size = 1024;
+    config.bins = 64;
+    config.scale = band_scale::BS_LOG;
+    config.stereo = stereo_mode::SM_MID_SIDE;
+    config.mode = analysis_mode::AM_INLINE;
+    return config;
+}
+
+static std::string output_path(const std::string& track, const std::string& root, const std::string& output_dir) {
+    if(output_dir.empty()) return track + ".zapf";
+
+    // Flatten the path below root into a single file name so that tracks in different folders cannot collide
+    std::string relative = track.compare(0, root.size(), root) == 0 ? track.substr(root.size()) : file_name(track);
+    while(!relative.empty() && (relative[0] == '/' || relative[0] == '\\')) relative.erase(0, 1);
+    for(auto& ch : relative) if(ch == '/' || ch == '\\') ch = '_';
+    return output_dir + "/" + relative + ".zapf";
+}
+
+static bool analyse_track(const track_job& job) {
+    mp3_stream source(job.path, analyse_frame_size, nullptr);
+    if(!source.start()) {
+        LOG_ERR("Failed to open " + job.path);
+        return false;
+    }
+
+    mp3_format format;
+    if(!probe_mp3(job.path, format)) {
+        LOG_ERR("Failed to read the format of " + job.path + ", assuming 44.1 kHz");
+        format.sample_rate = 44100;
+    }
+
+    // The analyser records the track as it would for the spectrogram cache and hands it over once it is destroyed
+    track_features features;
+    {
+        const analyser_config config = make_config(format.sample_rate);
+        analyser_stream analyser(&source, config);
+        analyser.begin_track(0, nullptr, 1);
+        analyser.on_track_analysed([&features](uint64_t, track_features&& track) { features = std::move(track); });
+
+        analyser_stream::buffer_t buffer(config.hop_size*config.channels);
+        while(analyser.read(buffer, buffer.size()) == buffer.size()) { }
+    }
+
+    if(features.frames() == 0) {
+        LOG_ERR("No audio decoded from " + job.path);
+        return false;
+    }
+
+    if(!write_features(job.output, features)) {
+        LOG_ERR("Failed to write " + job.output);
+        return false;
+    }
+    return true;
+}
+
+static void usage() {
+    std::printf("usage: zapAnalyse [-j threads] [-o output_dir] path...\n");
+}
+
+int main(int argc, char* argv[]) {
+    size_t threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    std::string output_dir;
+    std::vector<std::string> roots;
+
+    for(int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if(arg == "-j" && i + 1 < argc)      threads = std::max(std::atoi(argv[++i]), 1);
+        else if(arg == "-o" && i + 1 < argc) output_dir = argv[++i];
+        else if(arg == "-h" || arg[0] == '-') {
+            usage();
+            return arg == "-h" ? 0 : 1;
+        }
+        else roots.push_back(arg);
+    }
+
+    if(roots.empty()) {
+        usage();
+        return 1;
+    }
+
+    std::vector<track_job> jobs;
+    for(const auto& root : roots) {
+        for(const auto& track : find_files(root, "mp3")) jobs.push_back({track, output_path(track, root, output_dir)});
+    }
+
+    std::printf("Analysing %zu tracks on %zu threads\n", jobs.size(), threads);
+
+    // The calling thread is one of the workers
+    worker_pool pool(threads - 1);
+    std::atomic<size_t> completed(0), failed(0);
+    std::mutex print_mtx;
+    pool.run(jobs.size(), [&](size_t idx) {
+        const bool ok = analyse_track(jobs[idx]);
+        if(!ok) ++failed;
+        const size_t count = ++completed;
+        std::lock_guard<std::mutex> lock(print_mtx);
+        std::printf("[%zu/%zu] %s%s\n", count, jobs.size(), ok ? "" : "FAILED ", jobs[idx].path.c_str());
+    });
+
+    std::printf("Analysed %zu tracks, %zu failed\n", jobs.size() - failed, size_t(failed));
+    return failed == 0 ? 0 : 2;
+}
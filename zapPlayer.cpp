@@ -1,31 +1,56 @@
 #include <QDial>
 #include <QDebug>
 #include <QSpinBox>
+#include <QSettings>
 #include <QFileDialog>
+#include <QStandardPaths>
 #include "zapPlayer.h"
 #include "ui_zapPlayer.h"
 #include "analyser_stream.hpp"
+#include "analyser_tap.hpp"
 #include "directory_stream.hpp"
 #include "controller_stream.hpp"
+#include "loudness_stream.hpp"
+#include "equaliser_stream.hpp"
+#include "reverb_stream.hpp"
+#include "float_stream.hpp"
+#include "resampler_stream.hpp"
+#include "mp3_probe.hpp"
 #include <zapAudio/streams/mp3_stream.hpp>
 #include <zapAudio/streams/sine_wave.hpp>
 #include <zapAudio/streams/buffered_stream.hpp>
 
-zapPlayer::zapPlayer(QWidget *parent) : QDialog(parent), ui(new Ui::zapPlayer), audio_out_(nullptr,2,44100,1024),
-    visualiser_(128) {
+// The delay between the controller handing a block to the device and the first sample being heard, by default the 1024
+// frame device buffer plus a margin for the driver.  It is set in the dialog and kept in the settings, hardware with
+// larger buffers needs more if the visuals lead.
+constexpr static int default_latency_ms = 35;
+
+// The device runs at one rate, sources at any other are resampled to it before the buffer
+constexpr static size_t device_rate = 44100;
+
+// Consecutive tracks in a folder overlap by this long once the silence between them is trimmed
+constexpr static float crossfade_seconds = 3.f;
+
+zapPlayer::zapPlayer(QWidget *parent) : QDialog(parent), ui(new Ui::zapPlayer), audio_out_(nullptr,2,device_rate,1024),
+    visualiser_(128), frame_{0, analyser_stream::frame_clock::time_point(), 0, analyser_stream::fft_buffer_t(128),
+    analyser_stream::fft_buffer_t(128), 0.f, 0.f, beat_state{0.f, 0.f, 0.f, false}, pitch_state{0.f, 0.f}},
+    clock_(device_rate, default_latency_ms/1000.f) {
     ui->setupUi(this);
 
+    QSettings settings("zapPlayer", "zapPlayer");
+    ui->spnLatency->setValue(settings.value("latency_ms", default_latency_ms).toInt());
+    clock_.set_latency(ui->spnLatency->value()/1000.f);
+
     setWindowFlags(Qt::WindowStaysOnTopHint);
     //setWindowOpacity(0.5f);
 
-    for(auto& s : streams_) s = nullptr;
-
     connect(ui->btnOpenFile, &QPushButton::clicked, this, &zapPlayer::openFile);
     connect(ui->btnOpenFolder, &QPushButton::clicked, this, &zapPlayer::openFolder);
     connect(ui->btnPlay, &QPushButton::clicked, this, &zapPlayer::play);
     connect(ui->btnStop, &QPushButton::clicked, this, &zapPlayer::stop);
     connect(ui->btnSkip, &QPushButton::clicked, this, &zapPlayer::skip_track);
     connect(ui->sldVolume, &QSlider::valueChanged, this, &zapPlayer::volumeChanged);
+    connect(ui->spnLatency, SIGNAL(valueChanged(int)), this, SLOT(latencyChanged(int)));
     connect(ui->btnPause, &QPushButton::clicked, this, &zapPlayer::pause);
 
     // We want to implement a pulse that feeds the FFT bins to the visualiser
@@ -49,10 +74,20 @@ zapPlayer::zapPlayer(QWidget *parent) : QDialog(parent), ui(new Ui::zapPlayer),
 }
 
 zapPlayer::~zapPlayer() {
+    sync_.stop();
     audio_out_.stop();
+    release_streams();
     delete ui;
 }
 
+void zapPlayer::release_streams() {
+    // Every stage reads from the one before it, so they are released from the device back to the source
+    output_.reset();
+    for(size_t i = 7; i-- != 0;) streams_[i].reset();
+    analyser_.reset();
+    decoder_.reset();
+}
+
 void zapPlayer::showEvent(QShowEvent* event) {
     QDialog::showEvent(event);
 }
@@ -71,25 +106,67 @@ void zapPlayer::openFolder() {
 }
 
 void zapPlayer::play() {
+    sync_.stop();
     if(audio_out_.is_playing() || audio_out_.is_paused()) audio_out_.stop();
 
-    if(audio_out_.get_stream()) {
-        // Shut down and clean up the old stream
-        delete streams_[0];
-        delete streams_[1];
-        delete streams_[2];
+    // Shut down and clean up the old chain, the device no longer reads from it
+    release_streams();
+
+    // The FFT stream taps the data on its way to audio_output, the transform itself runs on the analyser's
+    // own threads so that the audio callback never waits on the FFT.  An 8192 point transform resolves the bass, 2048
+    // the mids and 512 keeps the treble responsive, each on its own core.  The 256 sample hop gives beat-reactive
+    // visuals and the 32 + 48 + 48 bands are log spaced over the audible range.  The bins follow the mid signal with
+    // the side bands and stereo width alongside.
+    analyser_config config;
+    config.hop_size = 256;
+    config.scale = band_scale::BS_LOG;
+    config.mode = analysis_mode::AM_TAP;
+    config.resolutions = {
+        resolution_config{8192, 32, 30.f, 250.f},
+        resolution_config{2048, 48, 250.f, 2000.f},
+        resolution_config{512, 48, 2000.f, 16000.f}
+    };
+    config.analysis_threads = 2;
+    config.stereo = stereo_mode::SM_MID_SIDE;
+
+    // Tracks played before are drawn from the spectrogram cache rather than transformed again
+    if(!cache_) {
+        const QString cache_dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/spectrograms";
+        if(!QDir().mkpath(cache_dir)) qDebug() << "Error creating spectrogram cache" << cache_dir;
+        cache_ = std::make_unique<spectrogram_cache>(cache_dir.toStdString(), config);
     }
 
-    audio_stream<short>* sourcestream_ptr;
+    // The analyser is fed by a tap further down the chain, it exists first so the first track can be announced to it
+    analyser_.reset(new analyser_stream(nullptr, config));
+    auto fft_ptr = analyser_.get();
+    fft_ptr->on_track_analysed([this](uint64_t key, track_features&& features) {
+        cache_->store(key, features);
+    });
+
+    // The decoded samples become float once at the source, by a float_stream or the resampler_stream for a file at
+    // another rate than the device's (the directory_stream does the same per track).  Every stage after works on
+    // float and the dither_stream converts to s16 once for the device.
+    audio_stream<float>* sourcestream_ptr;
+    directory_stream* pathstream_ptr = nullptr;
 
     if(is_folder_) {
-        auto pathstream_ptr = new directory_stream(path_.toStdString(), 1024);
+        pathstream_ptr = new directory_stream(path_.toStdString(), 1024, device_rate);
+        pathstream_ptr->set_crossfade(crossfade_seconds, crossfade_curve::CC_EQUAL_POWER);
+        streams_[0].reset(pathstream_ptr);
 
         pathstream_ptr->on_next_track([this](const std::string& filename) {
             QString file = filename.c_str();
             QMetaObject::invokeMethod(this, "onNextTrack", Qt::QueuedConnection, Q_ARG(QString, file));
         });
 
+        // Every track is announced to the analyser before its first sample is read.  The directory_stream's decode
+        // thread opens each track, the first included, and looks it up in the cache.
+        pathstream_ptr->set_cache(cache_.get());
+        pathstream_ptr->on_track_start([fft_ptr](const std::string& filename, uint64_t position,
+                                                 directory_stream::feature_map_ptr cache, uint64_t key) {
+            fft_ptr->begin_track(position/2, cache, key);
+        });
+
         if(!pathstream_ptr->start()) {
             qDebug() << "Error starting directory_stream";
             return;
@@ -97,35 +174,70 @@ void zapPlayer::play() {
         sourcestream_ptr = pathstream_ptr;
     } else {
         auto filestream_ptr = new mp3_stream(path_.toStdString(), 1024, nullptr);
+        decoder_.reset(filestream_ptr);
         if(!filestream_ptr->start()) {
             qDebug() << "Error starting mp3_stream";
             return;
         }
-        sourcestream_ptr = filestream_ptr;
+
+        mp3_format format;
+        if(probe_mp3(path_.toStdString(), format) && format.sample_rate != device_rate) {
+            qDebug() << "Resampling from" << format.sample_rate << "Hz";
+            sourcestream_ptr = new resampler_stream(filestream_ptr, format.sample_rate, device_rate, 2, 1024);
+        } else {
+            sourcestream_ptr = new float_stream(filestream_ptr, 2, 1024);
+        }
+        streams_[0].reset(sourcestream_ptr);
         ui->txtFilename->setText(path_);
+
+        uint64_t key;
+        auto cache = cache_->lookup(path_.toStdString(), key);
+        fft_ptr->begin_track(0, cache, key);
     }
 
     // This is a buffering stream to prevent I/O blocking interfering with audio output
-    auto buffer_ptr = new buffered_stream<short>(64*1024, 32*1024, 60, sourcestream_ptr);
+    auto buffer_ptr = new buffered_stream<float>(64*1024, 32*1024, 60, sourcestream_ptr);
+    streams_[1].reset(buffer_ptr);
     if(!buffer_ptr->start()) {
         qDebug() << "Error starting buffering stream";
         return;
     }
 
-    // This is the FFT stream that produces the FFT transform just before sending the data to audio_output
-    auto fft_ptr = new analyser_stream(buffer_ptr);
+    // The analyser taps the chain after the buffer and ahead of the effects so it follows the music, not the settings
+    auto tap_ptr = new analyser_tap(buffer_ptr, fft_ptr, 2, 1024);
+    streams_[2].reset(tap_ptr);
+
+    // Loudness is measured ahead of the volume control so the readings follow the music rather than the volume setting
+    auto loudness_ptr = new loudness_stream<float>(tap_ptr, device_rate, 2);
+    streams_[3].reset(loudness_ptr);
+
+    // The equaliser runs in the chain on the device's 1024 frame blocks, its bands start flat
+    auto eq_ptr = new equaliser_stream<float>(loudness_ptr, device_rate, 2, 1024);
+    streams_[4].reset(eq_ptr);
+
+    // The reverb convolves with the impulse response in reverb.wav in the application's data directory, without one it
+    // passes the audio through.  Its 1024 frame partitions match the device's blocks so it adds no delay unless the
+    // buffer underruns.
+    auto reverb_ptr = new reverb_stream<float>(eq_ptr, device_rate, 2, 1024);
+    streams_[5].reset(reverb_ptr);
+    const QString impulse = QStandardPaths::locate(QStandardPaths::AppDataLocation, "reverb.wav");
+    if(!impulse.isEmpty() && !reverb_ptr->load_impulse(impulse.toStdString())) {
+        qDebug() << "Error loading impulse response" << impulse;
+    }
 
-    // The Controller Stream (Panning, Volume, effects (reverb?)
-    auto controller_ptr = new controller_stream<short>(fft_ptr, 44100, 2, 1024);
+    // The Controller Stream (Panning, Volume)
+    auto controller_ptr = new controller_stream<float>(reverb_ptr, device_rate, 2, 1024);
+    controller_ptr->set_clock(&clock_);
+    streams_[6].reset(controller_ptr);
 
-    streams_[0] = sourcestream_ptr;
-    streams_[1] = buffer_ptr;
-    streams_[2] = fft_ptr;
-    streams_[3] = controller_ptr;
+    auto output_ptr = new dither_stream(controller_ptr, 2, 1024);
+    output_.reset(output_ptr);
 
-    audio_out_.set_stream(controller_ptr);
+    audio_out_.set_stream(output_ptr);
 
+    clock_.reset();
     audio_out_.play();
+    frame_.sequence = 0;
     sync_.start(0);
 }
 
@@ -141,30 +253,42 @@ void zapPlayer::pause() {
 }
 
 void zapPlayer::skip_track() {
-    if(auto ptr = dynamic_cast<directory_stream*>(streams_[0])) {
+    if(auto ptr = dynamic_cast<directory_stream*>(streams_[0].get())) {
         ptr->skip_track();
     }
 }
 
 void zapPlayer::sync() {
-    analyser_stream::fft_buffer_t buf(128);
-    auto ptr = static_cast<analyser_stream*>(streams_[2]);
-    auto len = ptr->copy_bins(buf, 128);
-    if(len != 128) {
-        qDebug() << "Mismatch";
+    // Show the frame for the sample being heard rather than the newest, which leads the sound by the device latency
+    auto ptr = analyser_.get();
+    if(ptr->frame_at(clock_.position(), frame_)) {
+        if(frame_.bins.size() != 128) {
+            qDebug() << "Mismatch";
+        }
+
+        visualiser_.set_frequency_bins(frame_.bins);
     }
 
-    visualiser_.set_frequency_bins(buf);
     visualiser_.update(0.f, .01f);
     ui->openGLWidget->update();
+
+    // A reverb response replaced on the audio thread is freed here rather than left until the next change
+    if(auto reverb_ptr = dynamic_cast<reverb_stream<float>*>(streams_[5].get())) {
+        reverb_ptr->release_retired();
+    }
 }
 
 void zapPlayer::volumeChanged(int volume) {
-    if(auto ptr = dynamic_cast<controller_stream<short>*>(streams_[3])) {
+    if(auto ptr = dynamic_cast<controller_stream<float>*>(streams_[6].get())) {
         ptr->set_volume(volume/100.f);
     }
 }
 
+void zapPlayer::latencyChanged(int milliseconds) {
+    clock_.set_latency(milliseconds/1000.f);
+    QSettings("zapPlayer", "zapPlayer").setValue("latency_ms", milliseconds);
+}
+
 void zapPlayer::onGLInit() {
     auto modules = visualiser_.get_visualisations();
     for(const auto& m : modules) ui->cbxVisualisation->addItem(m.c_str());
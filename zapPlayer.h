@@ -4,7 +4,11 @@
 #include <QDialog>
 #include <zapAudio/audio_output.hpp>
 #include <QTimer>
+#include <memory>
 #include "visualiser.hpp"
+#include "analyser_stream.hpp"
+#include "spectrogram_cache.hpp"
+#include "dsp/playback_clock.hpp"
 
 namespace Ui {
 class zapPlayer;
@@ -32,11 +36,14 @@ public slots:
     void onNextTrack(const QString&);
 
     void volumeChanged(int volume);
+    void latencyChanged(int milliseconds);
 
     void onGLInit();
     void moduleChanged(const QString&);
 
 private:
+    void release_streams();
+
     Ui::zapPlayer* ui;
 
     audio_output_s16 audio_out_;
@@ -44,8 +51,16 @@ private:
     QString path_;
     bool is_folder_;    // Is the path a folder or a file
 
-    audio_stream<short>* streams_[4];
+    // Every stage is owned here, none owns its parent.  streams_ is the float chain: the source, buffer, analyser tap,
+    // loudness, equaliser, reverb and controller.
+    std::unique_ptr<audio_stream<short>> decoder_;         // A single file's mp3_stream, converted by streams_[0]
+    std::unique_ptr<audio_stream<float>> streams_[7];
+    std::unique_ptr<analyser_stream> analyser_;
+    std::unique_ptr<audio_stream<short>> output_;          // The dithered conversion for the device
     visualiser visualiser_;
+    analyser_stream::bin_frame frame_;
+    playback_clock clock_;
+    std::unique_ptr<spectrogram_cache> cache_;
 
     QTimer sync_;
 };
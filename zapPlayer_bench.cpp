@@ -0,0 +1,416 @@
+/* Created by Darren Otgaar on 2026/10/17. http://www.github.com/otgaard/zap */
+
+/*
+ * zapPlayer_bench, timing and accuracy of the analysis stages.  Only the dsp/ code is linked so the benchmark builds
+ * without Qt, GL or zapAudio.  Every stage is timed per frame for frame sizes 256 to 16384, the FFT once per SIMD
+ * level the CPU supports, and the FFTs and dB conversion are checked against double precision references.  The Q15
+ * FFT is timed including its windowing, compare it with window_s16 plus fft_forward.  The loudness meter and the
+ * equaliser are timed on blocks of size stereo frames, the equaliser including a copy of its input, and the convolver
+ * on the same blocks with partitions of size frames of a three second stereo impulse response.  The resampler converts
+ * size stereo frames from 96 kHz to 44.1 kHz, the dither converts size stereo frames of float to s16 and the crossfade
+ * mixes two float blocks of size stereo frames.
+ *
+ *     zapPlayer_bench [-csv file] [-json file] [-t ms]
+ *
+ * A stage is repeated for at least ms milliseconds (default 100) in each of five trials and the fastest trial is
+ * reported, the minimum being the measurement least disturbed by the rest of the system.
+ */
+
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+#include <functional>
+#include "dsp/fft.hpp"
+#include "dsp/fft_q15.hpp"
+#include "dsp/convolver.hpp"
+#include "dsp/window.hpp"
+#include "dsp/cpu_features.hpp"
+#include "dsp/equaliser.hpp"
+#include "dsp/resampler.hpp"
+#include "dsp/sample_ops.hpp"
+#include "dsp/loudness_meter.hpp"
+#include "dsp/spectrum_ops.hpp"
+
+constexpr static size_t bench_min_size = 256;
+constexpr static size_t bench_max_size = 16384;
+constexpr static size_t bench_trials = 5;
+constexpr static double bench_two_pi = 6.28318530717958647692;
+
+struct bench_result {
+    std::string stage;
+    std::string simd;
+    size_t size;
+    double ns_per_frame;
+    double max_error;           // Negative where the stage has no reference
+    double rms_error;
+};
+
+static volatile float bench_sink;   // Keeps the measured work observable
+
+// The fastest of bench_trials runs of fnc in ns per call, each run lasting at least min_time
+static double time_stage(const std::function<void()>& fnc, std::chrono::nanoseconds min_time) {
+    using clock = std::chrono::steady_clock;
+    fnc();                      // Warm the caches and any lazily built tables
+
+    double best = 0.;
+    for(size_t trial = 0; trial != bench_trials; ++trial) {
+        size_t iterations = 0;
+        const auto start = clock::now();
+        auto elapsed = clock::duration::zero();
+        do {
+            for(size_t i = 0; i != 16; ++i) fnc();
+            iterations += 16;
+            elapsed = clock::now() - start;
+        } while(elapsed < min_time);
+
+        const double ns = std::chrono::duration<double, std::nano>(elapsed).count()/iterations;
+        if(trial == 0 || ns < best) best = ns;
+    }
+    return best;
+}
+
+// Double precision DFT of real input, bins() values of re and im
+static void reference_dft(const std::vector<float>& input, std::vector<double>& re, std::vector<double>& im) {
+    const size_t N = input.size(), bins = N/2 + 1;
+    std::vector<double> cos_table(N), sin_table(N);
+    for(size_t n = 0; n != N; ++n) {
+        cos_table[n] = std::cos(bench_two_pi*n/N);
+        sin_table[n] = std::sin(bench_two_pi*n/N);
+    }
+
+    re.assign(bins, 0.);
+    im.assign(bins, 0.);
+    for(size_t k = 0; k != bins; ++k) {
+        double sum_re = 0., sum_im = 0.;
+        size_t phase = 0;
+        for(size_t n = 0; n != N; ++n) {
+            sum_re += input[n]*cos_table[phase];
+            sum_im -= input[n]*sin_table[phase];
+            phase = (phase + k) & (N - 1);
+        }
+        re[k] = sum_re;
+        im[k] = sum_im;
+    }
+}
+
+// Errors relative to the largest reference magnitude
+static void spectrum_error(const float* re, const float* im, const std::vector<double>& ref_re,
+                           const std::vector<double>& ref_im, double& max_error, double& rms_error) {
+    double peak = 0., max_err = 0., sum_sq = 0.;
+    for(size_t k = 0; k != ref_re.size(); ++k) {
+        peak = std::max(peak, std::hypot(ref_re[k], ref_im[k]));
+        const double err = std::hypot(re[k] - ref_re[k], im[k] - ref_im[k]);
+        max_err = std::max(max_err, err);
+        sum_sq += err*err;
+    }
+    max_error = peak > 0. ? max_err/peak : 0.;
+    rms_error = peak > 0. ? std::sqrt(sum_sq/ref_re.size())/peak : 0.;
+}
+
+static void bench_fft(size_t N, const std::vector<float>& signal, std::chrono::nanoseconds min_time,
+                      std::vector<bench_result>& results) {
+    std::vector<double> ref_re, ref_im;
+    reference_dft(signal, ref_re, ref_im);
+
+    const simd_level levels[] = { simd_level::SL_SCALAR, simd_level::SL_SSE2, simd_level::SL_AVX2 };
+    for(auto requested : levels) {
+        if(supported_simd_level(requested) != requested) continue;
+
+        real_fft fft(N, requested);
+        std::vector<float> re(fft.bins()), im(fft.bins()), output(N), work(N);
+        const double forward_ns = time_stage([&] {
+            fft.forward(signal.data(), re.data(), im.data());
+            bench_sink = re[1];
+        }, min_time);
+
+        double max_error, rms_error;
+        fft.forward(signal.data(), re.data(), im.data());
+        spectrum_error(re.data(), im.data(), ref_re, ref_im, max_error, rms_error);
+        results.push_back({"fft_forward", simd_level_name(requested), N, forward_ns, max_error, rms_error});
+
+        const double inverse_ns = time_stage([&] {
+            fft.inverse(re.data(), im.data(), output.data(), work.data());
+            bench_sink = output[1];
+        }, min_time);
+
+        // The round trip error relative to the signal peak
+        fft.inverse(re.data(), im.data(), output.data(), work.data());
+        double peak = 0., max_err = 0., sum_sq = 0.;
+        for(size_t n = 0; n != N; ++n) {
+            const double err = double(output[n])/N - signal[n];
+            peak = std::max(peak, double(std::fabs(signal[n])));
+            max_err = std::max(max_err, std::fabs(err));
+            sum_sq += err*err;
+        }
+        results.push_back({"fft_inverse", simd_level_name(requested), N, inverse_ns, max_err/peak,
+                           std::sqrt(sum_sq/N)/peak});
+    }
+}
+
+// The fixed-point path windows and transforms s16 samples in one call, it is compared with the float window applied
+// to the same samples
+static void bench_q15(size_t N, std::mt19937& rng, std::chrono::nanoseconds min_time,
+                      std::vector<bench_result>& results) {
+    std::uniform_int_distribution<int> sample_dist(-16384, 16383);
+    std::vector<short> samples(N);
+    for(auto& s : samples) s = short(sample_dist(rng));
+
+    const auto window = get_window(window_type::WT_HANN, N);
+    std::vector<int16_t> q15_window(N);
+    float_to_q15(window->data(), q15_window.data(), N);
+
+    std::vector<float> windowed(N);
+    for(size_t n = 0; n != N; ++n) windowed[n] = samples[n]*(*window)[n];
+    std::vector<double> ref_re, ref_im;
+    reference_dft(windowed, ref_re, ref_im);
+
+    const simd_level levels[] = { simd_level::SL_SCALAR, best_simd_level() };
+    for(auto requested : levels) {
+        q15_real_fft fft(N, requested);
+        if(requested != simd_level::SL_SCALAR && !fft.simd()) continue;
+
+        std::vector<int16_t> re(fft.bins()), im(fft.bins());
+        const double ns = time_stage([&] {
+            bench_sink = float(fft.forward(samples.data(), q15_window.data(), re.data(), im.data()));
+        }, min_time);
+
+        const int exponent = fft.forward(samples.data(), q15_window.data(), re.data(), im.data());
+        std::vector<float> fre(fft.bins()), fim(fft.bins());
+        q15_to_float(re.data(), fre.data(), fft.bins(), std::ldexp(1.f, exponent));
+        q15_to_float(im.data(), fim.data(), fft.bins(), std::ldexp(1.f, exponent));
+
+        double max_error, rms_error;
+        spectrum_error(fre.data(), fim.data(), ref_re, ref_im, max_error, rms_error);
+        results.push_back({"fft_q15", fft.simd() ? "ssse3" : "scalar", N, ns, max_error, rms_error});
+    }
+}
+
+static void bench_stages(size_t N, std::mt19937& rng, std::chrono::nanoseconds min_time,
+                         std::vector<bench_result>& results) {
+    // These stages are not dispatched, SSE2 is compiled in where the target has it
+#if defined(ZAPPLAYER_SSE2)
+    const char* simd = simd_level_name(simd_level::SL_SSE2);
+#else
+    const char* simd = simd_level_name(simd_level::SL_SCALAR);
+#endif
+    const size_t bins = N/2 + 1;
+
+    std::uniform_int_distribution<int> sample_dist(-32768, 32767);
+    std::vector<short> samples(N);
+    for(auto& s : samples) s = short(sample_dist(rng));
+
+    const auto window = get_window(window_type::WT_HANN, N);
+    std::vector<float> windowed(N);
+    const double window_ns = time_stage([&] {
+        apply_window_s16(samples.data(), window->data(), windowed.data(), N, 1.f/32768.f);
+        bench_sink = windowed[1];
+    }, min_time);
+    results.push_back({"window_s16", simd, N, window_ns, -1., -1.});
+
+    real_fft fft(N);
+    std::vector<float> re(bins), im(bins), power(bins), db(bins), smoothed(bins);
+    fft.forward(windowed.data(), re.data(), im.data());
+
+    const float scale = 1.f/(float(N)*N);
+    const double power_ns = time_stage([&] {
+        power_spectrum(re.data(), im.data(), power.data(), bins, scale);
+        bench_sink = power[1];
+    }, min_time);
+    results.push_back({"power_spectrum", simd, N, power_ns, -1., -1.});
+
+    // The dB error is absolute, in dB
+    const double db_ns = time_stage([&] {
+        power_to_db(power.data(), db.data(), bins);
+        bench_sink = db[1];
+    }, min_time);
+    double max_error = 0., sum_sq = 0.;
+    for(size_t k = 0; k != bins; ++k) {
+        const double err = db[k] - 10.*std::log10(std::max(double(power[k]), 1e-20));
+        max_error = std::max(max_error, std::fabs(err));
+        sum_sq += err*err;
+    }
+    results.push_back({"power_to_db", simd, N, db_ns, max_error, std::sqrt(sum_sq/bins)});
+
+    spectral_smoother smoother(bins, .5f, .1f);
+    const double smooth_ns = time_stage([&] {
+        smoother.process(db.data(), smoothed.data());
+        bench_sink = smoothed[1];
+    }, min_time);
+    results.push_back({"smoother", simd, N, smooth_ns, -1., -1.});
+
+    // N stereo frames, the size of a device block rather than an analysis frame
+    std::vector<short> block(2*N);
+    for(auto& s : block) s = short(sample_dist(rng));
+    loudness_meter meter(44100.f, 2);
+    const double loudness_ns = time_stage([&] {
+        meter.process(block.data(), N);
+        bench_sink = meter.block_peak();
+    }, min_time);
+    results.push_back({"loudness", simd, N, loudness_ns, -1., -1.});
+
+    // Ten peaking bands on N stereo frames in [-1, 1]
+    std::vector<float> eq_block(2*N), eq_input(2*N);
+    s16_to_float(block.data(), eq_input.data(), 2*N, 1.f/32768.f);
+    equaliser eq(44100.f, 2);
+    std::vector<eq_band> eq_bands;
+    for(size_t b = 0; b != equaliser::max_bands; ++b) {
+        eq_bands.push_back({ eq_filter::EF_PEAK, 31.25f*float(1 << b), b % 2 ? 3.f : -3.f, 1.f });
+    }
+    eq.set_bands(eq_bands.data(), eq_bands.size());
+    const double eq_ns = time_stage([&] {
+        std::copy(eq_input.begin(), eq_input.end(), eq_block.begin());
+        eq.process(eq_block.data(), N);
+        bench_sink = eq_block[1];
+    }, min_time);
+    results.push_back({"equaliser", simd, N, eq_ns, -1., -1.});
+
+    // A decaying noise response of three seconds at 44.1 kHz, the cost is fixed by its length in partitions
+    const size_t response_frames = 3*44100;
+    std::normal_distribution<float> noise_dist(0.f, 1.f);
+    std::vector<float> response(2*response_frames);
+    for(size_t i = 0; i != response.size(); ++i) response[i] = .01f*noise_dist(rng)*std::exp(-float(i/2)/22050.f);
+    convolver conv(N, 2, response.data(), 2, response_frames);
+    std::vector<float> conv_block(2*N);
+    const double conv_ns = time_stage([&] {
+        conv.process(eq_input.data(), conv_block.data());
+        bench_sink = conv_block[1];
+    }, min_time);
+    results.push_back({"convolver", simd, N, conv_ns, -1., -1.});
+
+    resampler rs(96000, 44100, 2, N);
+    std::vector<float> rs_output(2*rs.max_output(N));
+    const double rs_ns = time_stage([&] {
+        rs.process(eq_input.data(), N, rs_output.data());
+        bench_sink = rs_output[1];
+    }, min_time);
+    results.push_back({"resampler", simd, N, rs_ns, -1., -1.});
+
+    uint32_t dither_state[4] = { 1u, 2u, 3u, 4u };
+    const double dither_ns = time_stage([&] {
+        float_to_s16_dither(eq_input.data(), block.data(), 2*N, 32768.f, dither_state);
+        bench_sink = block[1];
+    }, min_time);
+    results.push_back({"dither", simd, N, dither_ns, -1., -1.});
+
+    // An equal power crossfade of N stereo frames into the next track's head
+    std::vector<float> fade_out(N), fade_in(N);
+    for(size_t f = 0; f != N; ++f) {
+        fade_out[f] = std::cos(1.5707963f*(f + .5f)/N);
+        fade_in[f] = std::sin(1.5707963f*(f + .5f)/N);
+    }
+    std::vector<float> head(eq_input.rbegin(), eq_input.rend()), mix(2*N);
+    const double xfade_ns = time_stage([&] {
+        crossfade(eq_input.data(), head.data(), mix.data(), 2, N, fade_out.data(), fade_in.data());
+        bench_sink = mix[1];
+    }, min_time);
+    results.push_back({"crossfade", simd, N, xfade_ns, -1., -1.});
+}
+
+static std::string compiler_name() {
+#if defined(__clang__)
+    return std::string("clang ") + __clang_version__;
+#elif defined(__GNUC__)
+    return std::string("gcc ") + __VERSION__;
+#elif defined(_MSC_VER)
+    return "msvc " + std::to_string(_MSC_FULL_VER);
+#else
+    return "unknown";
+#endif
+}
+
+static std::string format_error(double error) {
+    if(error < 0.) return std::string();
+    char str[32];
+    std::snprintf(str, sizeof(str), "%.3e", error);
+    return str;
+}
+
+static bool write_csv(const std::string& path, const std::vector<bench_result>& results) {
+    FILE* file = std::fopen(path.c_str(), "w");
+    if(!file) return false;
+    std::fprintf(file, "stage,simd,size,ns_per_frame,max_error,rms_error\n");
+    for(const auto& r : results) {
+        std::fprintf(file, "%s,%s,%zu,%.1f,%s,%s\n", r.stage.c_str(), r.simd.c_str(), r.size, r.ns_per_frame,
+                     format_error(r.max_error).c_str(), format_error(r.rms_error).c_str());
+    }
+    return std::fclose(file) == 0;
+}
+
+static bool write_json(const std::string& path, const std::vector<bench_result>& results) {
+    FILE* file = std::fopen(path.c_str(), "w");
+    if(!file) return false;
+
+    const auto& cpu = get_cpu_features();
+    std::fprintf(file, "{\n  \"compiler\": \"%s\",\n", compiler_name().c_str());
+    std::fprintf(file, "  \"simd\": \"%s\",\n", simd_level_name(best_simd_level()));
+    std::fprintf(file, "  \"cpu\": {\"sse2\": %s, \"ssse3\": %s, \"sse41\": %s, \"avx2\": %s, \"fma\": %s},\n",
+                 cpu.sse2 ? "true" : "false", cpu.ssse3 ? "true" : "false", cpu.sse41 ? "true" : "false",
+                 cpu.avx2 ? "true" : "false", cpu.fma ? "true" : "false");
+    std::fprintf(file, "  \"results\": [\n");
+    for(size_t i = 0; i != results.size(); ++i) {
+        const auto& r = results[i];
+        std::fprintf(file, "    {\"stage\": \"%s\", \"simd\": \"%s\", \"size\": %zu, \"ns_per_frame\": %.1f",
+                     r.stage.c_str(), r.simd.c_str(), r.size, r.ns_per_frame);
+        if(r.max_error >= 0.) {
+            std::fprintf(file, ", \"max_error\": %.3e, \"rms_error\": %.3e", r.max_error, r.rms_error);
+        }
+        std::fprintf(file, "}%s\n", i + 1 != results.size() ? "," : "");
+    }
+    std::fprintf(file, "  ]\n}\n");
+    return std::fclose(file) == 0;
+}
+
+static void usage() {
+    std::printf("usage: zapPlayer_bench [-csv file] [-json file] [-t ms]\n");
+}
+
+int main(int argc, char* argv[]) {
+    std::string csv_path, json_path;
+    int min_ms = 100;
+
+    for(int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if(arg == "-csv" && i + 1 < argc)       csv_path = argv[++i];
+        else if(arg == "-json" && i + 1 < argc) json_path = argv[++i];
+        else if(arg == "-t" && i + 1 < argc)    min_ms = std::max(std::atoi(argv[++i]), 1);
+        else {
+            usage();
+            return arg == "-h" ? 0 : 1;
+        }
+    }
+
+    const std::chrono::nanoseconds min_time = std::chrono::milliseconds(min_ms);
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> signal_dist(-1.f, 1.f);
+
+    std::vector<bench_result> results;
+    for(size_t N = bench_min_size; N <= bench_max_size; N <<= 1) {
+        std::vector<float> signal(N);
+        for(auto& s : signal) s = signal_dist(rng);
+
+        bench_fft(N, signal, min_time, results);
+        bench_q15(N, rng, min_time, results);
+        bench_stages(N, rng, min_time, results);
+    }
+
+    std::printf("%-16s%-8s%8s%14s%12s%12s\n", "stage", "simd", "size", "ns/frame", "max err", "rms err");
+    for(const auto& r : results) {
+        std::printf("%-16s%-8s%8zu%14.1f%12s%12s\n", r.stage.c_str(), r.simd.c_str(), r.size, r.ns_per_frame,
+                    format_error(r.max_error).c_str(), format_error(r.rms_error).c_str());
+    }
+
+    if(!csv_path.empty() && !write_csv(csv_path, results)) {
+        std::fprintf(stderr, "Failed to write %s\n", csv_path.c_str());
+        return 2;
+    }
+    if(!json_path.empty() && !write_json(json_path, results)) {
+        std::fprintf(stderr, "Failed to write %s\n", json_path.c_str());
+        return 2;
+    }
+    return 0;
+}